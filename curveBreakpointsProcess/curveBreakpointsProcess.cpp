@@ -13,16 +13,46 @@
  * 
  * This program requires C++20 or up to compile:
  *
- *  g++ -std=c++20 -Wall process_curve.cpp -o process_curve
+ *  g++ -std=c++20 -Wall -O2 -pthread process_curve.cpp -o process_curve
  *
  *  or: 
  *
- *  clang++ -std=c++20 -Wall process_curve.cpp -o process_curve
+ *  clang++ -std=c++20 -Wall -O2 -pthread process_curve.cpp -o process_curve
  *   
  * Run the program and following the prompts:
  * 
  *  ./process_curve
  * 
+ * or reduce a whole directory (or glob) of curve files without any prompt, spread over all the cores:
+ *
+ *  ./process_curve --batch curves/ --count 200 --jobs 16 --out reduced
+ *  ./process_curve --batch 'curves/sensor_*.340' --error 0.005
+ *
+ * Curves can be converted to a binary file, which is memory mapped and loaded without parsing:
+ *
+ *  ./process_curve --convert sensor.340 sensor.crvb
+ *
+ * A curve that keeps coming through a pipe is reduced on the fly with an error bound:
+ *
+ *  acquire | ./process_curve --stream --error 0.005 > reduced.curve
+ *
+ * Or run as a service that keeps parsed curves in memory, requests are sent as text lines on a Unix domain socket:
+ *
+ *  ./process_curve --serve /tmp/curves.sock --jobs 8
+ *  printf 'LOAD pt100 sensor.340\nREDUCE pt100 COUNT 200 greedy\nLOOKUP pt100 101.5 120\n' | nc -U /tmp/curves.sock
+ *
+ * The engines can be benchmarked on synthetic curves, the results are printed as JSON lines:
+ *
+ *  ./process_curve --bench --sizes 1e3,1e5,1e7 --reps 3 --engine greedy --count 200
+ *
+ * and compared with each other on a corpus of real curves, as CSV (the port of the C version, strategy legacy, only if named):
+ *
+ *  ./process_curve --compare 'curves/sensor_*.340' --count 200 --reps 5 > engines.csv
+ *
+ * Run ./process_curve --help for all the options.
+ *
+ * The Makefile builds this program and the C version, make test runs the differential checks of curveBreakpointsProcess_test.cpp.
+ *
  */ 
 
 #include <iostream>
@@ -39,9 +69,51 @@
 #include <cmath>
 //#include <cstring>
 #include <fstream>
+#include <limits>
+#include <thread>
+#include <functional>
+#include <cstdint>
+#include <deque>
+#include <queue>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <list>
+#include <atomic>
+#include <shared_mutex>
+#include <map>
+#include <charconv>
+#include <chrono>
+#include <span>
+#include <memory_resource>
+#include <numeric>
+#include <random>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <cerrno>
+#include <glob.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 //#include <regex>   // for slice string. Not used anymore
 
 #define DEVIATIONINC  0.007 // 0.0005            // deviation increase at each loop
+#define LEGACYDEVIATIONINC 0.0005               // deviation increase of the C process_curve(), see reduce_legacy()
+#define DEVIATIONEPS  1e-9                       // relative width of the bisection bracket at which the search stops
+#define OPTIMALEXACTLIMIT 2e8                    // largest K * n^2 / 2 the optimal engine solves exactly, unless forced (--exact)
+#define OPTIMALAPPROXNAME "optimal-approx"       // the optimal engine is reported under this name when it is not exact
+#define STREAMWINDOW  4096                       // default number of breakpoints the streaming reducer keeps to feed again
+#define LOOKUPBENCHREADINGS (1 << 20)            // readings converted per run of the lookup benchmark
+#ifndef PARSECHUNKMIN
+#define PARSECHUNKMIN (4 << 20)                  // bytes of breakpoint lines a parser thread gets at least (the tests shrink it)
+#endif
+#define VALIDATECHUNKMIN (1 << 20)               // breakpoints a validation thread gets at least
 
 #define DEBUG
 #undef DEBUG
@@ -58,441 +130,4021 @@
 #define DBGPRINT(fmt, ...)
 #endif
 
+/*
+ * Scaled int32 fixed point value, the way the devices store a curve: value = raw / 10^Decimals. It converts to and from double
+ * implicitly, so the engines calculate with it as with a double.
+ */
+template<int Decimals>
+struct FixedPoint
+{
+	static constexpr double scale = [] { double s = 1; for(int i = 0; i < Decimals; i++) s *= 10; return s; }();
+	int32_t raw{0};
+
+	FixedPoint() = default;
+	FixedPoint(double v) : raw{static_cast<int32_t>(std::lround(std::clamp(v * scale, -2147483647.0, 2147483647.0)))} {}  // see fits()
+	operator double() const { return raw / scale; }
+
+	// v is in range, the constructor would clamp it otherwise (a NaN is not)
+	static bool fits(double v) { return std::fabs(v * scale) <= 2147483647.0; }
+};
+
+using Fixed32 = FixedPoint<4>;                      // 4 decimals, up to +-214748.3647
+
 /* 
  * A function just use a constructor to create this class object and push it onto a list or vector make 
- * things much simple */
-struct BreakPoint
+ * things much simple.
+ * The values are stored as V: double, float or Fixed32. A float or fixed point curve takes half the memory and bandwidth, all
+ * the calculations (slopes, deviations, errors) are still done in double. */
+template<typename V>
+struct BasicBreakPoint
 {
 
-	double sensorUnit;
-	double temp;
+	V sensorUnit;
+	V temp;
 
-	BreakPoint(double r, double c):sensorUnit{r}, temp{c}
+	BasicBreakPoint(double r, double c):sensorUnit(static_cast<V>(r)), temp(static_cast<V>(c))
 	{
 	};
-	~BreakPoint() = default;
+	~BasicBreakPoint() = default;
 
 };
 
-class ProcessCurve
-{
-    private:
-	std::vector<std::string> curveHDR;
-	std::vector<BreakPoint> origCurveBP;
-	std::vector<BreakPoint> pickedCurveBP;
-	std::string fileName;
+using BreakPoint = BasicBreakPoint<double>;
 
-    public:
-	ProcessCurve() = default;
-	~ProcessCurve() = default;
-        int print_BP() const;
-	int get_fileName();
-	int parse_curve_file();     // parse the curve file and pickout header field and breakpoint and store them on curveHDR and vector.
-	int validate_data();
-	int process_curve_BP();     // do calculation to see if wee need to merge breakpoints to reduce number of the breakpoints.
-       	int save_processed_BP();    // save processed breakpoints and header into a file.
-};
+// digits the breakpoints of a value type are saved with, a float has no more
+template<typename V> constexpr int printDigits = 10;
+template<> constexpr int printDigits<float> = 7;
+
+template<typename V> constexpr const char *valueTypeName = "double";
+template<> constexpr const char *valueTypeName<float> = "float";
+template<> constexpr const char *valueTypeName<Fixed32> = "fixed";
 
-// Pickout tokens from a string according to delimeters
-void pickOutTokens(const std::string &str,
-		   std::vector<std::string>& tokens, 
-		   std::string_view delims)
+/* Whether v can be stored as V as it is: a fixed point value would be clamped, a finite value beyond the largest float would turn
+ * into infinity. Curves are checked with it when they are read or edited, values that do not fit are refused. */
+template<typename V>
+static bool value_fits(double v)
 {
-    std::size_t start = str.find_first_not_of(delims, 0), end = 0;
-    while((end = str.find_first_of(delims, start)) != std::string::npos)
-    {
-        tokens.push_back(str.substr(start, end - start));
-        start = str.find_first_not_of(delims, end);
-    }
-    if(start != std::string::npos)
-        tokens.push_back(str.substr(start));
+	if constexpr(std::is_same_v<V, float>)
+		return !std::isfinite(v) || std::fabs(v) <= std::numeric_limits<float>::max();
+	else if constexpr(std::is_same_v<V, Fixed32>)
+		return Fixed32::fits(v);
+	else
+		return true;
 }
 
-int ProcessCurve::print_BP() const
+// The point value types a curve can be processed in (--precision)
+enum class Precision
 {
-	int count{ 0 };
-	//for(BreakPoint element : origCurveBP)
-	for(auto element : origCurveBP)
+	Double,
+	Float,
+	Fixed
+};
+
+/* Call f with a value of the type precision selects, f(double{}), f(float{}) or f(Fixed32{}). */
+template<typename F>
+static auto with_precision(Precision precision, F &&f)
+{
+	switch(precision)
 	{
-		std::cout << "original BP: the " << count << " element - r is: " << element.sensorUnit << std::endl;
-		std::cout << "original BP: the " << count << " element - t is: " << element.temp << std::endl;
-		count++;
+	case Precision::Float:
+		return f(float{});
+	case Precision::Fixed:
+		return f(Fixed32{});
+	default:
+		return f(double{});
 	}
+}
 
-	std::cout << std::endl;
-	count = 0;
-		
-	for(auto element : pickedCurveBP)
+static const char *precision_name(Precision precision)
+{
+	switch(precision)
 	{
-		std::cout << "picked BP: the " << count << " element - sensorUnit " << element.sensorUnit << std::endl;
-		std::cout << "picked BP: the " << count << " element - temperature " << element.temp << std::endl;
-		count++;
+	case Precision::Float:
+		return "float";
+	case Precision::Fixed:
+		return "fixed";
+	default:
+		return "double";
 	}
-
-	return 0;
 }
 
+/*
+ * Instrumentation: wall time of the stages and counters, summed over all ProcessCurve objects and threads. Nothing is recorded
+ * unless metricsEnabled is set (--metrics), the cost is then one predictable branch per stage, pass or arena block. The totals
+ * are written as one JSON object or as Prometheus text when the program ends.
+ * The allocation counters count the blocks of the curve arenas. Built with -DCOUNTALLOCATIONS, the global operator new is replaced
+ * and every heap allocation of the program is counted instead, at the cost of that branch on every allocation even without
+ * --metrics.
+ */
+enum Stage { StageParse, StageValidate, StageReduce, StageSave, NumStages };
+static const char *const stageNames[NumStages] = {"parse", "validate", "reduce", "save"};
 
-/* Parse curve file and pickout all the breakpoints to prepare for further process. */
-int ProcessCurve::parse_curve_file()
+struct CurveMetrics
 {
-	bool bppstarted = false;    // if breakpoint process has started or not 
-	const std::string delim = " ";
-	const std::string delim_comment = "#";
-	std::size_t found_pos;
-	std::vector<std::string>tokens;
-
-    	dprintf("ProcessCurv::process_curv_BP() is called.\n");
-
-    	// open the file for read
-    	std::ifstream inf{fileName.c_str()};
-    	if(!inf)
-    	{
-    		std::cerr << "Unable to open file: " << fileName << std::endl;
-    		return -1;
-   	}
-
-   	// read and process the curve file
-   	while(inf)
-   	{
-		std::string strInput;
-		std::getline(inf, strInput);
-
-		/* If a line begin with #, it is a comment line, skip it.
-		 * It is suggested that we should not covert a std::string into a raw char array, instead
-		 * We convert it into a char vector: */
-#if 0
-		std::vector<char> cVect(strInput.begin(), strInput.end());
-      		char *cp = &cVect[0];
-      		//auto cp = std::begin(strInput);    // JT, this works also !
-		dprintf("DEBUG:::=============>: Read and process the curve file...\n");
-      		while(*cp == ' ' || *cp == '\t')
-         		cp++;
-      		if(*cp == '#')
-         		continue;
-#endif
-      		// skip empty lines
-    		if(strInput.length() == 0)
-		{
-        		continue;
-		}
-
-		// skip comment lines. It can be: "# xxx", " # xxx" or " #"
-		int firstnws = strInput.find_first_not_of(delim, 0);          // skip front whitespace whitespace
-		int pos1 = strInput.find_first_of(delim_comment, firstnws);
-		if(pos1 == firstnws)
-		{
-			continue;
-		}
-
-		/* After we use string vector for curve header, we do not need to process header in this program, and just
-		* push all header fields into the vector. */
-		if(((found_pos = strInput.find(":")) != std::string::npos) && bppstarted == false)
-		{
-			curveHDR.push_back(strInput); 
-			continue;
-		}
-		else if(((found_pos = strInput.find(":")) != std::string::npos) && bppstarted == true)
-		{
-			std::cerr << "Wrong curve format!" << std::endl;
-			return -1;
-		};
-		dprintf("DEBUGG:: =======> read in string: %s\n", strInput.c_str());
+	std::atomic<uint64_t> stageNs[NumStages]{};
+	std::atomic<uint64_t> stageCalls[NumStages]{};
+	std::atomic<uint64_t> lines{0};                 // lines of text curve files parsed
+	std::atomic<uint64_t> bpIn{0};                  // breakpoints of the curves reduced
+	std::atomic<uint64_t> bpOut{0};                 // breakpoints picked out of them
+	std::atomic<uint64_t> passes{0};                // deviation passes (loops) of the reductions
+	std::atomic<uint64_t> merges{0};                // breakpoints merged away by the deviation passes and the greedy engine
+	std::atomic<uint64_t> allocations{0};           // arena blocks, or every heap allocation with COUNTALLOCATIONS
+	std::atomic<uint64_t> bytesAllocated{0};
 
-		// Now, headers is done, we mark it to make sure that there should be no header field in middle of breakpoint section.
-		if(!bppstarted)
-			bppstarted = true;
+	std::string json() const;
+	std::string prometheus() const;
+};
 
-		tokens.clear();
+static bool metricsEnabled = false;
+static CurveMetrics metrics;
 
-		// Some customer tool add sequence number in the BP section. So, we need to figure out if there is a sequence number
-		// in the BP section. Pick out those tokens
-		pickOutTokens(strInput, tokens, delim);
+#define METRIC_ADD(counter, n)                                                      \
+    do                                                                              \
+    {                                                                               \
+        if(metricsEnabled)                                                          \
+            metrics.counter.fetch_add((n), std::memory_order_relaxed);              \
+    } while (0)
 
-		if(tokens.size() == 3)
-		{                       // 3 tokens means there is sequence number	
-			double r = atof(tokens[1].c_str());
-			double t = atof(tokens[2].c_str());
-			dprintf("DEBUG:: double: r = %f\n", r);
-			BreakPoint bp{r, t};
-			origCurveBP.push_back(bp);
-		}
-		else if(tokens.size() == 2)
-		{                       // 2 tokens, no sequence number
-			double r = atof(tokens[0].c_str());
-			double t = atof(tokens[1].c_str());
-			BreakPoint bp{r, t};
-			origCurveBP.push_back(bp); 					
-		}
+std::string CurveMetrics::json() const
+{
+	char buf[256];
+	std::string r = "{\"stages\":{";
+	for(int s = 0; s < NumStages; s++)
+	{
+		snprintf(buf, sizeof(buf), "%s\"%s\":{\"calls\":%lu,\"seconds\":%.9f}", s ? "," : "", stageNames[s],
+			 stageCalls[s].load(), stageNs[s].load() / 1e9);
+		r += buf;
 	}
+	snprintf(buf, sizeof(buf), "},\"lines\":%lu,\"breakpoints_in\":%lu,\"breakpoints_out\":%lu,\"passes\":%lu,\"merges\":%lu,"
+		 "\"allocations\":%lu,\"bytes_allocated\":%lu}", lines.load(), bpIn.load(), bpOut.load(), passes.load(), merges.load(),
+		 allocations.load(), bytesAllocated.load());
+	return r + buf;
+}
 
-	dprintf("DEBUGG:::===> Process curve file is done. Number of BPs is: %ld\n", origCurveBP.size());
+std::string CurveMetrics::prometheus() const
+{
+	char buf[256];
+	std::string r = "# HELP curve_stage_seconds_total Wall time spent in a stage.\n# TYPE curve_stage_seconds_total counter\n";
+	for(int s = 0; s < NumStages; s++)
+	{
+		snprintf(buf, sizeof(buf), "curve_stage_seconds_total{stage=\"%s\"} %.9f\n", stageNames[s], stageNs[s].load() / 1e9);
+		r += buf;
+	}
+	r += "# HELP curve_stage_calls_total Number of times a stage has run.\n# TYPE curve_stage_calls_total counter\n";
+	for(int s = 0; s < NumStages; s++)
+	{
+		snprintf(buf, sizeof(buf), "curve_stage_calls_total{stage=\"%s\"} %lu\n", stageNames[s], stageCalls[s].load());
+		r += buf;
+	}
 
-	return 0;
+	const std::pair<const char *, const std::atomic<uint64_t> *> counters[] = {
+		{"curve_lines_parsed_total", &lines}, {"curve_breakpoints_in_total", &bpIn}, {"curve_breakpoints_out_total", &bpOut},
+		{"curve_deviation_passes_total", &passes}, {"curve_merges_total", &merges}, {"curve_allocations_total", &allocations},
+		{"curve_allocated_bytes_total", &bytesAllocated}};
+	for(auto &[name, value] : counters)
+	{
+		snprintf(buf, sizeof(buf), "# TYPE %s counter\n%s %lu\n", name, name, value->load());
+		r += buf;
+	}
+	return r;
 }
 
-int ProcessCurve::get_fileName()
+// Adds the wall time from construction to destruction to a stage
+class StageTimer
 {
-	std::cout << "Enter the curve file name you want to process: " << std::endl;
-	std::getline(std::cin >> std::ws, fileName);
-	if(!std::filesystem::exists(fileName))
+    private:
+	Stage stage;
+	std::chrono::steady_clock::time_point start;
+
+    public:
+	explicit StageTimer(Stage s) : stage{s}
 	{
-		std::cout << "File: " << fileName << " dose not exist!" << std::endl;
-		return -1;
+		if(metricsEnabled)
+			start = std::chrono::steady_clock::now();
 	}
-	else
-		std::cout << "OK, file: " << fileName << " exist!" << std::endl;
+	~StageTimer()
+	{
+		if(!metricsEnabled)
+			return;
+		auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+		metrics.stageNs[stage].fetch_add(ns, std::memory_order_relaxed);
+		metrics.stageCalls[stage].fetch_add(1, std::memory_order_relaxed);
+	}
+	StageTimer(const StageTimer &) = delete;
+	StageTimer &operator=(const StageTimer &) = delete;
+};
 
-   	// convert std string into C string:
-   	printf("Covert fileName from STD string to C string: %s\n", fileName.c_str());
-	
-   	return 0;
+#ifdef COUNTALLOCATIONS
+// Counting global allocation functions, they only count while the instrumentation is enabled
+void *operator new(size_t size)
+{
+	METRIC_ADD(allocations, 1);
+	METRIC_ADD(bytesAllocated, size);
+	void *p = malloc(size ? size : 1);
+	if(!p)
+		throw std::bad_alloc();
+	return p;
 }
 
+// not inlined, gcc takes the free() of a new'ed pointer for a mismatch otherwise
+__attribute__((noinline)) void operator delete(void *p) noexcept { free(p); }
+__attribute__((noinline)) void operator delete(void *p, size_t) noexcept { free(p); }
+#endif
+
+/*
+ * Binary min-heap of breakpoint indexes keyed by a cost. The position of every index in the heap is tracked, so the
+ * cost of an index still in the heap can be changed or the index removed in O(log n).
+ */
+class IndexedMinHeap
+{
+    private:
+	std::vector<size_t> heap;               // heap of indexes
+	std::vector<size_t> pos;                // position of an index in heap, npos if not in heap
+	std::vector<double> key;
 
-int ProcessCurve::validate_data(){
+	static constexpr size_t npos = static_cast<size_t>(-1);
 
-	auto checkSeq{
-		[](const BreakPoint& a, const BreakPoint& b)
+	bool less(size_t a, size_t b) const { return key[heap[a]] < key[heap[b]]; }
+	void swap_at(size_t a, size_t b)
+	{
+		std::swap(heap[a], heap[b]);
+		pos[heap[a]] = a;
+		pos[heap[b]] = b;
+	}
+	void sift_up(size_t i)
+	{
+		while(i > 0 && less(i, (i - 1) / 2))
 		{
-			return (a.sensorUnit  > b.sensorUnit); 
+			swap_at(i, (i - 1) / 2);
+			i = (i - 1) / 2;
 		}
-	};
-
-	if(!origCurveBP.empty()){
-		std::vector<BreakPoint>::iterator it;
-		it = std::ranges::adjacent_find(origCurveBP, checkSeq);
-		if(it != origCurveBP.end()){
-			std::cout << "File error!" << '\n';
-			return -1;
+	}
+	void sift_down(size_t i)
+	{
+		while(1)
+		{
+			size_t l = 2 * i + 1, r = l + 1, m = i;
+			if(l < heap.size() && less(l, m))
+				m = l;
+			if(r < heap.size() && less(r, m))
+				m = r;
+			if(m == i)
+				break;
+			swap_at(i, m);
+			i = m;
 		}
-		else
-			std::cout << "Validation passed!" << '\n';
 	}
-	return 0;
-}
 
-int ProcessCurve::process_curve_BP()
-{
-	std::string line;
-	class BreakPoint *start1BP{}, *end1BP{}, *start2BP{}, *end2BP{};    // TODO: use 3: startBP, middleBP, endBP
-	//std::vector<BreakPoint>::iterator itr = origCurveBP.begin();
-	float deviat = 0;               
-   	double tang1=0, tang2=0, deltT=0;
-   	int loops = 0;
-	int origIndex = 0;
-	std::string numBPs;
-	size_t numOfBreakpoints;
-	size_t numPickedBP = 0;
+    public:
+	IndexedMinHeap() = default;
+	explicit IndexedMinHeap(size_t n) : pos(n, npos), key(n, 0) { heap.reserve(n); }
 
-	int vsize = origCurveBP.size();
-	if(vsize < 3)
+	// empty the heap for indexes below n, keeping the memory
+	void reset(size_t n)
 	{
-		std::cout << "Too few break points!" << std::endl;
-		return -1;
-	} 
+		heap.clear();
+		heap.reserve(n);
+		pos.assign(n, npos);
+		key.assign(n, 0);
+	}
 
-try_again:
+	bool empty() const { return heap.empty(); }
+	size_t size() const { return heap.size(); }
+	bool contains(size_t idx) const { return pos[idx] != npos; }
+	size_t top() const { return heap.front(); }
+	double top_key() const { return key[heap.front()]; }
 
-	std::cout << "How many break points you want to have/keep?" << std::endl;
-	std::getline(std::cin >> std::ws, numBPs);
-	numOfBreakpoints = atoi(numBPs.c_str());
-	// we control the number fall in between 20 - 200;
+	void push(size_t idx, double k)
+	{
+		key[idx] = k;
+		pos[idx] = heap.size();
+		heap.push_back(idx);
+		sift_up(heap.size() - 1);
+	}
 
-	/* The number can not be reduced to less than the following:
-     	 * NumberOfBPs / 2 + 1
-	 *  If we have 31 BPs,   we got 31/2 + 2 = 17
-	 */ 
-	if(numOfBreakpoints < (origCurveBP.size() / 2 + 2))
+	size_t pop()
 	{
-		std::cout << "Number of breakpoints should not less than " << origCurveBP.size() / 2 + 2 <<  std::endl;
-		goto try_again;
+		size_t idx = heap.front();
+		swap_at(0, heap.size() - 1);
+		heap.pop_back();
+		pos[idx] = npos;
+		if(!heap.empty())
+			sift_down(0);
+		return idx;
 	}
 
-	if(numOfBreakpoints > origCurveBP.size())
+	void update(size_t idx, double k)
 	{
-		std::cout << "Curve breakpoints is OK, no need to do further process!" << std::endl;
-		return 1;
+		double old = key[idx];
+		key[idx] = k;
+		if(k < old)
+			sift_up(pos[idx]);
+		else
+			sift_down(pos[idx]);
 	}
+};
 
-	dprintf("DEBUG::: 1 =====> size of origCurveBP: %ld\n", origCurveBP.size());
+/*
+ * Read-only memory mapping of a whole file, unmapped when the object goes away.
+ */
+class MappedFile
+{
+    private:
+	const char *data{nullptr};
+	size_t length{0};
 
-calculate:
+    public:
+	MappedFile() = default;
+	~MappedFile() { close(); }
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
 
-	origIndex = 0; 
-    	loops++;
-	dprintf("DEBUGG::: 2 =====> LOOP: %d; %s\n", loops, " +++++++++++++");
+	int open(const std::string &name)
+	{
+		close();
+		int fd = ::open(name.c_str(), O_RDONLY);
+		if(fd < 0)
+			return -1;
+		struct stat st;
+		if(fstat(fd, &st) < 0)
+		{
+			::close(fd);
+			return -1;
+		}
+		length = st.st_size;
+		if(length > 0)
+		{
+			void *p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+			if(p == MAP_FAILED)
+			{
+				::close(fd);
+				length = 0;
+				return -1;
+			}
+			madvise(p, length, MADV_SEQUENTIAL);
+			data = static_cast<const char *>(p);
+		}
+		::close(fd);                                // the mapping stays valid after close
+		return 0;
+	}
 
-	// at least there are 3 breakpoints
-	start1BP = &origCurveBP[origIndex];                            // [0] points to the first BP
-	
-	pickedCurveBP.push_back(origCurveBP[origIndex]);               // [0], the first BP should always be picked.
-	origIndex++;
-	end1BP = &origCurveBP[origIndex];                              // [1], next 
-	dprintf("DEBUGG::::: 3 ======> end1BP->temp = %f\n", end1BP->temp); 
-    	start2BP = end1BP;                                             // start breakpoint of second section
-   
-	origIndex++;
-	end2BP = &origCurveBP[origIndex];                              // [2], we have a end breakpoint of second section if it is not the end of the curve table
+	void close()
+	{
+		if(data)
+			munmap(const_cast<char *>(data), length);
+		data = nullptr;
+		length = 0;
+	}
 
-	while(1)
+	std::string_view view() const { return {data, length}; }
+};
+
+/*
+ * Bump allocator for the storage of one curve (header fields and breakpoints). Memory is handed out of big blocks and only given
+ * back all at once by reset(), which keeps the blocks (merged into one if the curve needed more than one), so a ProcessCurve that
+ * is reused file after file stops allocating once its arena is big enough for the largest curve.
+ */
+class CurveArena : public std::pmr::memory_resource
+{
+    private:
+	static constexpr size_t minBlock = 64 * 1024;
+	std::vector<std::pair<std::unique_ptr<std::byte[]>, size_t>> blocks;
+	size_t block{0};                                // block allocated from
+	size_t used{0};                                 // bytes used of it
+
+	void add_block(size_t size)
 	{
-		dprintf("DEBUGG::: 4 start1BP = %f, end1BP = %f\n", start1BP->temp, end1BP->temp);
-		dprintf("DEBUGG::: 5 start2BP = %f, end2BP = %f\n", start2BP->temp, end2BP->temp);
-		// we calculate the tangent of the two sections
-		tang1 = (end1BP->temp - start1BP->temp) / (end1BP->sensorUnit - start1BP->sensorUnit); 
-		tang2 = (end2BP->temp - start2BP->temp) / (end2BP->sensorUnit - start2BP->sensorUnit);
-		std::cout << "tang1: " << tang1 << std::endl; 
+#ifndef COUNTALLOCATIONS
+		METRIC_ADD(allocations, 1);                 // operator new counts it otherwise
+		METRIC_ADD(bytesAllocated, size);
+#endif
+		blocks.emplace_back(std::make_unique<std::byte[]>(size), size);
+		block = blocks.size() - 1;
+		used = 0;
+	}
 
-		printf("Tang2 = %f, tang1 = %f\n", tang2, tang1);
-		printf("Deviation = %f\n", deviat);
-		
-		// calculate the delta and compare it with the allowed deviation. 4 cases:  
-		if((tang1 > 0 && tang2 > 0) || (tang1 < 0 && tang2 < 0))  // both sections asending or decending
-		{
-			deltT = fabs(tang1 - tang2);
-			dprintf("DEBUG::: 6 ====> deltT = %f, origIndex = %d\n", deltT, origIndex);
-			if(deltT > deviat)
-			{  // can not merge 
-				pickedCurveBP.push_back(*start2BP);
-				dprintf("DEBUG::: 7 ====> 1 picked temperature: %f\n", start2BP->temp); 
-				start1BP = start2BP;          // no merge, just continue
-				end1BP = end2BP;
-				start2BP = end2BP;
-				origIndex++;
-				if(origIndex < vsize)
-				{
-					end2BP = &origCurveBP[origIndex];
-					continue;
-				}
-				else {
-					// reached end
-					pickedCurveBP.push_back(*start2BP);
-					break;
-				}
-			}
-			else if(deltT <= deviat)
-			{   // can merge this 2 sectons
-				std::cout << "DEBUG::: ===> merged a section <===" << std::endl;
-				start1BP = end2BP;
-				pickedCurveBP.push_back(*start1BP);       // always pick the start1 BP, and need to advance fro end2BP
-				origIndex++;                              // for end1BP = start2BP
-				if(origIndex < vsize)
-				{   // if there is more BP
-					end1BP = &origCurveBP[origIndex];
-					start2BP = end1BP;
-					origIndex++;                          // for end2BP
-					// more BP to process?
-					if(origIndex < vsize)
-					{         
-						end2BP = &origCurveBP[origIndex]; // ...yes
-						continue;
-					}
-					else{                
-						pickedCurveBP.push_back(*start2BP);
-						break;
-					}
-				}
-				else {                                    // no, pick the end1BP = start2BP and break
-					break;
-				}
-			}
-		}
-		else  // one section asending and another section desending 
-		{
-			deltT = fabs(tang1) + abs(tang2);
-			std::cout << "DEBUG::: 8 ===> deltT = " << deltT << "  origIndex = " << origIndex << std::endl; 
-			if(deltT > deviat)
-			{   // can not merge this 2 sections
-				pickedCurveBP.push_back(*start2BP);
-				std::cout << "DEBUG::: 9 ====> 2 picked temperature: " << start2BP->temp << std::endl; 
-				start1BP = start2BP;         // no merge, just continue
-				end1BP = end2BP;
-				start2BP = end2BP;
-				origIndex++;
-				if(origIndex < vsize)
+	void *do_allocate(size_t bytes, size_t align) override
+	{
+		while(1)
+		{
+			if(block < blocks.size())
+			{
+				void *p = blocks[block].first.get() + used;
+				size_t space = blocks[block].second - used;
+				if(std::align(align, bytes, p, space))
 				{
-					end2BP = &origCurveBP[origIndex];
-					continue;
-				}
-				else {
-					// reached end
-					pickedCurveBP.push_back(*start2BP);
-					break;
+					used = blocks[block].second - space + bytes;
+					return p;
 				}
 			}
-			else{    // we can merge this 2 section
-				start1BP = end2BP;
-				pickedCurveBP.push_back(*start1BP);        // always pick the start1 BP, and need to advance fro end2BP
-				origIndex++;                               // for end1BP = start2BP
-				if(origIndex < vsize )
-				{             // if there is more BP
-					end1BP = &origCurveBP[origIndex];
-					start2BP = end1BP;
-					origIndex++;                          // for end2BP
-					if(origIndex < vsize)
-					{         // more BP to process?
-						end2BP = &origCurveBP[origIndex]; // ...yes
-						continue;
-					}
-					else{                
-						pickedCurveBP.push_back(*start2BP);
-						break;
-					}
-				}
-				else {                                   // no, pick the end1BP = start2BP and break
-					break;
-				}
+			if(block + 1 < blocks.size())
+			{
+				block++;
+				used = 0;
 			}
+			else
+				add_block(std::max({minBlock, bytes + align, blocks.empty() ? 0 : blocks.back().second * 2}));
 		}
+	}
 
-	}  // end of while(1)
-   
-	if(numPickedBP == pickedCurveBP.size())
-		return 0;
-	else
-		numPickedBP = pickedCurveBP.size();
-	/* now the curve is processed with an allowed deviation, we check to see how many breakpoints have been picked out. If it is still 
-   	* too many than the user wanted, we increase the allowed deviation and jump to the outside loop and continue to process.
-   	* if the number of picked out breakpoint is equal or smaller than the user wanted, then we stop loop and problem solved. */
-	dprintf("DEBUG :::: pickedCurveBP size() = %ld\n", pickedCurveBP.size());
-	
-	if(pickedCurveBP.size() > numOfBreakpoints )
+	void do_deallocate(void *, size_t, size_t) override {}
+
+	bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override { return this == &other; }
+
+    public:
+	CurveArena() = default;
+	CurveArena(const CurveArena &) = delete;
+	CurveArena &operator=(const CurveArena &) = delete;
+
+	// everything allocated is given up, nothing may still use it
+	void reset()
 	{
-    	deviat += DEVIATIONINC;     // If there are still too many breakpoints, we increase the allowed deviation gradually
-      	dprintf("Change Deviation to ==>:: %f for next loop\n", deviat);
+		if(blocks.size() > 1)
+		{
+			size_t total = 0;
+			for(auto &b : blocks)
+				total += b.second;
+			blocks.clear();
+			add_block(total);
+		}
+		block = 0;
+		used = 0;
+	}
+};
+
+/*
+ * Binary curve file. A versioned header, the curve header fields and the breakpoints as two separate aligned double arrays
+ * (structure of arrays), so a curve can be memory mapped and loaded without any parsing:
+ *
+ *   CurveBinHeader
+ *   header fields: numHeaders times (uint32_t length, length chars)
+ *   padding to CURVEBINALIGN, numBP sensor units (double)
+ *   padding to CURVEBINALIGN, numBP temperatures (double)
+ *
+ * Values are stored in the byte order of the machine that writes the file.
+ */
+#define CURVEBINMAGIC    "CURVEBIN"
+#define CURVEBINVERSION  1
+#define CURVEBINALIGN    64
+#define CURVEBINEXT      ".crvb"
 
-		// we clean the pickedCurveBP vector and prepare for another try.
-		pickedCurveBP.clear();
+struct CurveBinHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t numHeaders;
+	uint64_t numBP;
+	uint64_t headerOffset;                          // offset of the header fields
+	uint64_t sensorUnitOffset;                      // offset of the sensor unit array, aligned to CURVEBINALIGN
+	uint64_t tempOffset;                            // offset of the temperature array, aligned to CURVEBINALIGN
+};
 
-		// The deviat set 0 at the begining, and it +DEVIATIONINC make it always > 0. Here is just a check, we can safely remove it.
-        goto calculate;
-   }
-   else
-   {
-        printf("\n\n\n################################################################################################\n");
-        printf("\n=======>>>: Total %d loops completed to get the results.  \n", loops);
-		printf("Number breakpoints picked out is: %ld\n", pickedCurveBP.size());
-        //printf("=======>>>: To reduce the breakpoints from %d to %d, the maximum deviation is %f <<<=========\n\n", ellCount(&breakPointList), numOfBreakpoints, deviat);
-        printf("#################################################################################################\n\n");
-   }
-    
+static bool is_binary_curve(std::string_view data)
+{
+	return data.size() >= sizeof(CurveBinHeader) && data.starts_with(std::string_view{CURVEBINMAGIC, 8});
+}
 
-   return 0;
+static bool is_binary_curve_name(const std::string &name)
+{
+	return name.ends_with(CURVEBINEXT);
 }
 
+// What a line of a curve file is
+enum class CurveLine
+{
+	Skip,          // empty, comment, or a breakpoint line without 2 or 3 tokens
+	Header,        // "field: value" before the breakpoints
+	BreakPoint,
+	Error          // header field in the middle of the breakpoint section
+};
+
+// atof() like conversion of a token, 0 if it does not start with a number
+static double to_double(std::string_view token)
+{
+	double v = 0;
+	if(!token.empty() && token.front() == '+')
+		token.remove_prefix(1);
+	std::from_chars(token.data(), token.data() + token.size(), v);
+	return v;
+}
 
-int main()
+/* Classify one line (without the newline) of a curve file and pick out the breakpoint from it. No memory is allocated.
+ * If a line begin with #, it is a comment line. A line with ":" is a header field, they must all come before the breakpoints.
+ * Some customer tool add sequence number in the BP section, so a breakpoint line has 3 tokens (sequence number, sensor unit,
+ * temperature) or 2 tokens (sensor unit, temperature). Tokens are separated by whitespace or tabs. */
+static CurveLine parse_curve_line(std::string_view line, bool &bppstarted, double &r, double &t)
 {
-	ProcessCurve pc;
-	pc.get_fileName();
-	pc.parse_curve_file();
-	if(pc.validate_data() < 0){
-		std::cout << "Data validation failed!" << '\n';
-		return 0;
+	constexpr std::string_view delims{" \t\r"};
+	std::string_view tokens[3];
+	size_t numTokens = 0;
+
+	// skip empty lines and comment lines. It can be: "# xxx", " # xxx" or " #"
+	size_t start = line.find_first_not_of(delims);
+	if(start == std::string_view::npos || line[start] == '#')
+		return CurveLine::Skip;
+
+	if(line.find(':') != std::string_view::npos)
+		return bppstarted ? CurveLine::Error : CurveLine::Header;
+
+	// Now, headers is done, we mark it to make sure that there should be no header field in middle of breakpoint section.
+	bppstarted = true;
+
+	while(start != std::string_view::npos)
+	{
+		size_t end = line.find_first_of(delims, start);
+		if(numTokens < 3)
+			tokens[numTokens] = line.substr(start, end == std::string_view::npos ? std::string_view::npos : end - start);
+		numTokens++;
+		start = end == std::string_view::npos ? end : line.find_first_not_of(delims, end);
 	}
-	pc.process_curve_BP();
-	pc.print_BP();
 
-	return 0;
-}	
+	if(numTokens == 3)
+	{                       // 3 tokens means there is sequence number	
+		r = to_double(tokens[1]);
+		t = to_double(tokens[2]);
+	}
+	else if(numTokens == 2)
+	{                       // 2 tokens, no sequence number
+		r = to_double(tokens[0]);
+		t = to_double(tokens[1]);
+	}
+	else
+		return CurveLine::Skip;
+
+	return CurveLine::BreakPoint;
+}
+
+/*
+ * Slope and deviation kernels of the deviation engine, an AVX2, an SSE2 and a scalar version, chosen at run time by CPU detection
+ * together with the error kernels of the reduction verifier below.
+ *
+ * slope_kernel:     slope[i] = slope of the section from breakpoint i to i + 1, for i < n - 1
+ *                   delta[i] = |slope[i - 1] - slope[i]|, the slope deviation at breakpoint i, for 0 < i < n - 1
+ *                   |tang1 - tang2| gives the same value as the 4 ascending/descending cases: for opposite signs it is |tang1| + |tang2|.
+ *                   Behaviour change: the original pass computed fabs(tang1) + abs(tang2) there, the int abs() truncated the
+ *                   second slope towards 0, so curves with opposite slopes below 1 per unit kept fewer breakpoints. Both slopes
+ *                   now count in full, some of those curves reduce to other breakpoints than before.
+ * threshold_kernel: bit i of keep is set if delta[i] > deviat, for 0 < i < n - 1 (a NaN deviation is never kept, like the pass
+ *                   always merged it)
+ * The point kernels are templates on the point value type, float and fixed point values are widened to double as they are
+ * loaded, so every value type gives the same results with every kernel.
+ */
+template<typename V> using SlopeKernel = void (*)(const BasicBreakPoint<V> *bp, size_t n, double *slope, double *delta);
+using ThresholdKernel = void (*)(const double *delta, size_t n, double deviat, uint64_t *keep);
+
+template<typename V>
+static void slope_kernel_scalar(const BasicBreakPoint<V> *bp, size_t n, double *slope, double *delta)
+{
+	for(size_t i = 0; i + 1 < n; i++)
+		slope[i] = (double(bp[i + 1].temp) - bp[i].temp) / (double(bp[i + 1].sensorUnit) - bp[i].sensorUnit);
+	for(size_t i = 1; i + 1 < n; i++)
+		delta[i] = fabs(slope[i - 1] - slope[i]);
+}
+
+static void threshold_kernel_scalar(const double *delta, size_t n, double deviat, uint64_t *keep)
+{
+	std::fill(keep, keep + (n + 63) / 64, 0);
+	for(size_t i = 1; i + 1 < n; i++)
+		keep[i / 64] |= (uint64_t)(delta[i] > deviat) << (i % 64);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+static_assert(sizeof(BasicBreakPoint<double>) == 2 * sizeof(double) && sizeof(BasicBreakPoint<float>) == 2 * sizeof(float)
+	      && sizeof(BasicBreakPoint<Fixed32>) == 2 * sizeof(int32_t), "BasicBreakPoint must be a pair of values for the SIMD kernels");
+
+// 2 or 4 consecutive values of a point value type as doubles
+__attribute__((target("sse2"))) static inline __m128d load2_pd(const double *p) { return _mm_loadu_pd(p); }
+__attribute__((target("sse2"))) static inline __m128d load2_pd(const float *p)
+{
+	return _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(p))));
+}
+template<int D>
+__attribute__((target("sse2"))) static inline __m128d load2_pd(const FixedPoint<D> *p)
+{
+	return _mm_div_pd(_mm_cvtepi32_pd(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(p))), _mm_set1_pd(FixedPoint<D>::scale));
+}
+
+__attribute__((target("avx2"))) static inline __m256d load4_pd(const double *p) { return _mm256_loadu_pd(p); }
+__attribute__((target("avx2"))) static inline __m256d load4_pd(const float *p) { return _mm256_cvtps_pd(_mm_loadu_ps(p)); }
+template<int D>
+__attribute__((target("avx2"))) static inline __m256d load4_pd(const FixedPoint<D> *p)
+{
+	return _mm256_div_pd(_mm256_cvtepi32_pd(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p))), _mm256_set1_pd(FixedPoint<D>::scale));
+}
+
+template<typename V>
+__attribute__((target("sse2")))
+static void slope_kernel_sse2(const BasicBreakPoint<V> *bp, size_t n, double *slope, double *delta)
+{
+	const V *p = reinterpret_cast<const V *>(bp);       // x0 y0 x1 y1 ...
+	const __m128d absMask = _mm_castsi128_pd(_mm_set1_epi64x(0x7fffffffffffffffLL));
+	size_t i = 0;
+
+	for(; i + 2 < n; i += 2)
+	{
+		__m128d d1 = _mm_sub_pd(load2_pd(p + 2 * i + 2), load2_pd(p + 2 * i));        // dx_i   dy_i
+		__m128d d2 = _mm_sub_pd(load2_pd(p + 2 * i + 4), load2_pd(p + 2 * i + 2));    // dx_i+1 dy_i+1
+		_mm_storeu_pd(slope + i, _mm_div_pd(_mm_unpackhi_pd(d1, d2), _mm_unpacklo_pd(d1, d2)));
+	}
+	for(; i + 1 < n; i++)
+		slope[i] = (double(bp[i + 1].temp) - bp[i].temp) / (double(bp[i + 1].sensorUnit) - bp[i].sensorUnit);
+
+	for(i = 1; i + 2 < n; i += 2)
+		_mm_storeu_pd(delta + i, _mm_and_pd(absMask, _mm_sub_pd(_mm_loadu_pd(slope + i - 1), _mm_loadu_pd(slope + i))));
+	for(; i + 1 < n; i++)
+		delta[i] = fabs(slope[i - 1] - slope[i]);
+}
+
+__attribute__((target("sse2")))
+static void threshold_kernel_sse2(const double *delta, size_t n, double deviat, uint64_t *keep)
+{
+	const __m128d dev = _mm_set1_pd(deviat);
+
+	std::fill(keep, keep + (n + 63) / 64, 0);
+	size_t i = 1;
+	for(; i % 64 != 0 && i + 1 < n; i++)
+		keep[0] |= (uint64_t)(delta[i] > deviat) << i;
+	for(; i + 64 < n; i += 64)
+	{
+		uint64_t bits = 0;
+		for(size_t k = 0; k < 64; k += 2)
+			bits |= (uint64_t)_mm_movemask_pd(_mm_cmpgt_pd(_mm_loadu_pd(delta + i + k), dev)) << k;
+		keep[i / 64] = bits;
+	}
+	for(; i + 1 < n; i++)
+		keep[i / 64] |= (uint64_t)(delta[i] > deviat) << (i % 64);
+}
+
+template<typename V>
+__attribute__((target("avx2")))
+static void slope_kernel_avx2(const BasicBreakPoint<V> *bp, size_t n, double *slope, double *delta)
+{
+	const V *p = reinterpret_cast<const V *>(bp);       // x0 y0 x1 y1 ...
+	const __m256d absMask = _mm256_castsi256_pd(_mm256_set1_epi64x(0x7fffffffffffffffLL));
+	size_t i = 0;
+
+	for(; i + 4 < n; i += 4)
+	{
+		__m256d d1 = _mm256_sub_pd(load4_pd(p + 2 * i + 2), load4_pd(p + 2 * i));      // dx_i dy_i dx_i+1 dy_i+1
+		__m256d d2 = _mm256_sub_pd(load4_pd(p + 2 * i + 6), load4_pd(p + 2 * i + 4));  // dx_i+2 dy_i+2 dx_i+3 dy_i+3
+		__m256d s = _mm256_div_pd(_mm256_unpackhi_pd(d1, d2), _mm256_unpacklo_pd(d1, d2));          // i, i+2, i+1, i+3
+		_mm256_storeu_pd(slope + i, _mm256_permute4x64_pd(s, 0xd8));
+	}
+	for(; i + 1 < n; i++)
+		slope[i] = (double(bp[i + 1].temp) - bp[i].temp) / (double(bp[i + 1].sensorUnit) - bp[i].sensorUnit);
+
+	for(i = 1; i + 4 < n; i += 4)
+		_mm256_storeu_pd(delta + i, _mm256_and_pd(absMask, _mm256_sub_pd(_mm256_loadu_pd(slope + i - 1), _mm256_loadu_pd(slope + i))));
+	for(; i + 1 < n; i++)
+		delta[i] = fabs(slope[i - 1] - slope[i]);
+}
+
+__attribute__((target("avx2")))
+static void threshold_kernel_avx2(const double *delta, size_t n, double deviat, uint64_t *keep)
+{
+	const __m256d dev = _mm256_set1_pd(deviat);
+
+	std::fill(keep, keep + (n + 63) / 64, 0);
+	size_t i = 1;
+	for(; i % 64 != 0 && i + 1 < n; i++)
+		keep[0] |= (uint64_t)(delta[i] > deviat) << i;
+	for(; i + 64 < n; i += 64)
+	{
+		uint64_t bits = 0;
+		for(size_t k = 0; k < 64; k += 4)
+			bits |= (uint64_t)_mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(delta + i + k), dev, _CMP_GT_OQ)) << k;
+		keep[i / 64] = bits;
+	}
+	for(; i + 1 < n; i++)
+		keep[i / 64] |= (uint64_t)(delta[i] > deviat) << (i % 64);
+}
+#endif
+
+/*
+ * Interpolation error kernels of the reduction verifier: for the count breakpoints at bp, the largest |temp - (y0 + slope *
+ * (sensorUnit - x0))| goes into maxError and the sum of their squares is added to sumSq.
+ */
+template<typename V> using ErrorKernel = void (*)(const BasicBreakPoint<V> *bp, size_t count, double x0, double y0, double slope, double &maxError, double &sumSq);
+
+template<typename V>
+static void error_kernel_scalar(const BasicBreakPoint<V> *bp, size_t count, double x0, double y0, double slope, double &maxError, double &sumSq)
+{
+	double m = 0, s = 0;
+	for(size_t i = 0; i < count; i++)
+	{
+		double e = fabs(bp[i].temp - (y0 + slope * (bp[i].sensorUnit - x0)));
+		m = std::max(m, e);
+		s += e * e;
+	}
+	maxError = m;
+	sumSq += s;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+template<typename V>
+__attribute__((target("sse2")))
+static void error_kernel_sse2(const BasicBreakPoint<V> *bp, size_t count, double x0, double y0, double slope, double &maxError, double &sumSq)
+{
+	const V *p = reinterpret_cast<const V *>(bp);
+	const __m128d absMask = _mm_castsi128_pd(_mm_set1_epi64x(0x7fffffffffffffffLL));
+	const __m128d vx0 = _mm_set1_pd(x0), vy0 = _mm_set1_pd(y0), vs = _mm_set1_pd(slope);
+	__m128d vmax = _mm_setzero_pd(), vsum = _mm_setzero_pd();
+	size_t i = 0;
+
+	for(; i + 2 <= count; i += 2)
+	{
+		__m128d a = load2_pd(p + 2 * i), b = load2_pd(p + 2 * i + 2);
+		__m128d xs = _mm_unpacklo_pd(a, b), ys = _mm_unpackhi_pd(a, b);
+		__m128d e = _mm_and_pd(absMask, _mm_sub_pd(ys, _mm_add_pd(vy0, _mm_mul_pd(vs, _mm_sub_pd(xs, vx0)))));
+		vmax = _mm_max_pd(vmax, e);
+		vsum = _mm_add_pd(vsum, _mm_mul_pd(e, e));
+	}
+
+	double m[2], s[2];
+	_mm_storeu_pd(m, vmax);
+	_mm_storeu_pd(s, vsum);
+	maxError = std::max(m[0], m[1]);
+	double rest = 0;
+	error_kernel_scalar<V>(bp + i, count - i, x0, y0, slope, m[0], rest);
+	maxError = std::max(maxError, m[0]);
+	sumSq += s[0] + s[1] + rest;
+}
+
+template<typename V>
+__attribute__((target("avx2")))
+static void error_kernel_avx2(const BasicBreakPoint<V> *bp, size_t count, double x0, double y0, double slope, double &maxError, double &sumSq)
+{
+	const V *p = reinterpret_cast<const V *>(bp);
+	const __m256d absMask = _mm256_castsi256_pd(_mm256_set1_epi64x(0x7fffffffffffffffLL));
+	const __m256d vx0 = _mm256_set1_pd(x0), vy0 = _mm256_set1_pd(y0), vs = _mm256_set1_pd(slope);
+	__m256d vmax = _mm256_setzero_pd(), vsum = _mm256_setzero_pd();
+	size_t i = 0;
+
+	for(; i + 4 <= count; i += 4)
+	{
+		__m256d a = load4_pd(p + 2 * i), b = load4_pd(p + 2 * i + 4);  // x0 y0 x1 y1, x2 y2 x3 y3
+		__m256d xs = _mm256_unpacklo_pd(a, b), ys = _mm256_unpackhi_pd(a, b);       // the order (0 2 1 3) does not matter here
+		__m256d e = _mm256_and_pd(absMask, _mm256_sub_pd(ys, _mm256_add_pd(vy0, _mm256_mul_pd(vs, _mm256_sub_pd(xs, vx0)))));
+		vmax = _mm256_max_pd(vmax, e);
+		vsum = _mm256_add_pd(vsum, _mm256_mul_pd(e, e));
+	}
+
+	double m[4], s[4];
+	_mm256_storeu_pd(m, vmax);
+	_mm256_storeu_pd(s, vsum);
+	maxError = std::max(std::max(m[0], m[1]), std::max(m[2], m[3]));
+	double rest = 0;
+	error_kernel_scalar<V>(bp + i, count - i, x0, y0, slope, m[0], rest);
+	maxError = std::max(maxError, m[0]);
+	sumSq += s[0] + s[1] + s[2] + s[3] + rest;
+}
+#endif
+
+template<typename V>
+struct SlopeKernels
+{
+	const char *name;
+	SlopeKernel<V> slope;
+	ThresholdKernel threshold;
+	ErrorKernel<V> error;
+};
+
+/* The best kernels this CPU supports, or the ones named by simd ("avx2", "sse2" or "scalar") if this CPU supports them. */
+template<typename V>
+static SlopeKernels<V> select_slope_kernels(std::string_view simd = {})
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_cpu_init();
+	if((simd.empty() || simd == "avx2") && __builtin_cpu_supports("avx2"))
+		return {"avx2", slope_kernel_avx2<V>, threshold_kernel_avx2, error_kernel_avx2<V>};
+	if((simd.empty() || simd == "sse2") && __builtin_cpu_supports("sse2"))
+		return {"sse2", slope_kernel_sse2<V>, threshold_kernel_sse2, error_kernel_sse2<V>};
+#endif
+	return {"scalar", slope_kernel_scalar<V>, threshold_kernel_scalar, error_kernel_scalar<V>};
+}
+
+// the kernels of every point value type
+template<typename V> static SlopeKernels<V> slopeKernels = select_slope_kernels<V>();
+
+static void select_all_slope_kernels(std::string_view simd)
+{
+	slopeKernels<double> = select_slope_kernels<double>(simd);
+	slopeKernels<float> = select_slope_kernels<float>(simd);
+	slopeKernels<Fixed32> = select_slope_kernels<Fixed32>(simd);
+}
+
+/*
+ * Greedy error bound reducer that takes the breakpoints one at a time and hands out every picked breakpoint as soon as it is
+ * decided. From the last picked breakpoint (the anchor), the window of chord slopes that keep every breakpoint passed so far
+ * within +-maxError is narrowed point by point. A breakpoint whose chord slope is inside the window can be reached, when the
+ * window becomes empty the furthest reachable breakpoint is picked as the next anchor and the breakpoints after it are fed again.
+ * The picks are breakpoints of the curve, not free vertices: the feasible slope window of the anchor (a convex hull in the
+ * general case) would give the fewest sections with vertices anywhere, but a picked curve has to be a subset of the original
+ * one. The furthest reachable breakpoint is not always the best anchor, an earlier one may reach further, so the result keeps
+ * the curve within the bound but is approximate: it can have more breakpoints than the fewest possible.
+ * Only the breakpoints behind the furthest reachable one are kept, they are the ones fed again. When window of them are pending
+ * the furthest reachable breakpoint is picked even though the slope window is not empty yet. This bounds the memory, the output
+ * latency and the breakpoints fed again to window per pick, n + picks * window feeds in all, at the cost of an extra breakpoint
+ * now and then. A long run of reachable breakpoints costs nothing.
+ */
+class StreamingReducer
+{
+    public:
+	// seq: number of breakpoints pushed before bp, seen: seq of the last breakpoint the pick of bp depends on, the number of
+	// breakpoints pushed if it was picked by finish()
+	using Emit = std::function<void(const BreakPoint &bp, size_t seq, size_t seen)>;
+
+	StreamingReducer(double maxError, size_t window, Emit emit)
+		: maxError{maxError}, window{std::max<size_t>(window, 1)}, emit{std::move(emit)}
+	{
+	}
+
+	void push(const BreakPoint &bp)
+	{
+		if(!started)
+		{
+			started = true;
+			anchor = bp;
+			pushed = 1;
+			emit(bp, 0, 0);                         // the first BP is always picked
+			return;
+		}
+		inbox.push_back({bp, pushed++});
+		drain();
+	}
+
+	// no more breakpoints, pick the rest, the last BP is always picked
+	void finish()
+	{
+		finished = true;
+		while(haveReach)
+		{
+			if(tail.empty())
+			{
+				anchor = reach.bp;
+				emit(anchor, reach.seq, pushed);
+				haveReach = false;
+				break;
+			}
+			restart();
+			drain();
+		}
+	}
+
+    private:
+	struct Fed
+	{
+		BreakPoint bp;
+		size_t seq;
+	};
+
+	double maxError;
+	size_t window;
+	Emit emit;
+	bool started{false};
+	bool finished{false};
+	size_t pushed{0};
+	BreakPoint anchor{0, 0};
+	double lo{-std::numeric_limits<double>::infinity()};
+	double hi{std::numeric_limits<double>::infinity()};
+	bool haveReach{false};                          // a breakpoint was fed since the anchor
+	Fed reach{{0, 0}, 0};                           // furthest reachable breakpoint since the anchor
+	std::vector<Fed> tail;                          // breakpoints fed after reach
+	std::deque<Fed> inbox;                          // breakpoints still to be fed
+
+	void drain()
+	{
+		while(!inbox.empty())
+		{
+			Fed f = inbox.front();
+			inbox.pop_front();
+			if(add(f))
+				restart();
+		}
+	}
+
+	// feed one breakpoint, true if the window is closed and the next anchor must be picked
+	bool add(const Fed &f)
+	{
+		const BreakPoint &bp = f.bp;
+		bool reachable = !haveReach;                // the next breakpoint can always be reached
+		haveReach = true;
+
+		double dx = bp.sensorUnit - anchor.sensorUnit;
+		bool closed = dx <= 0;                      // same sensor unit as the anchor, no chord through both
+		if(!closed)
+		{
+			double dy = bp.temp - anchor.temp;
+			double slope = dy / dx;
+			reachable = reachable || (slope >= lo && slope <= hi);
+			lo = std::max(lo, (dy - maxError) / dx);
+			hi = std::min(hi, (dy + maxError) / dx);
+			closed = lo > hi;
+		}
+		if(reachable)
+		{
+			reach = f;
+			tail.clear();
+		}
+		else
+			tail.push_back(f);
+		return closed || tail.size() >= window;
+	}
+
+	// pick the furthest reachable breakpoint as the new anchor, the breakpoints after it are fed again
+	void restart()
+	{
+		anchor = reach.bp;
+		emit(anchor, reach.seq, finished ? pushed : (tail.empty() ? reach.seq : tail.back().seq));
+		inbox.insert(inbox.begin(), tail.begin(), tail.end());
+		tail.clear();
+		haveReach = false;
+		lo = -std::numeric_limits<double>::infinity();
+		hi = std::numeric_limits<double>::infinity();
+	}
+};
+
+/*
+ * Temperature lookup over a reduced curve: sensor unit in, linearly interpolated temperature out. Readings outside the curve are
+ * extrapolated from its first or last section. Two ways to find the section of a reading:
+ *
+ *   Eytzinger: the breakpoint sensor units are laid out as an implicit binary tree in breadth first order, so the top levels of
+ *              the tree share a few cache lines. The search has no branch on the comparison and prefetches the descendants 3
+ *              levels ahead, O(log K).
+ *   Grid:      a uniform grid over the sensor unit range, every cell holds the first section that reaches into it. A reading
+ *              starts there and moves on past the breakpoints inside its cell, O(1) when the grid has a cell per breakpoint or more.
+ */
+class CurveLookup
+{
+    public:
+	enum class Mode
+	{
+		Eytzinger,
+		Grid
+	};
+
+	CurveLookup() = default;
+	template<typename V>
+	explicit CurveLookup(const std::vector<BasicBreakPoint<V>> &bp, Mode mode = Mode::Eytzinger, size_t gridCells = 0) { build(bp, mode, gridCells); }
+
+	template<typename V>
+	int build(const std::vector<BasicBreakPoint<V>> &bp, Mode mode = Mode::Eytzinger, size_t gridCells = 0);
+	Mode mode() const { return lookupMode; }
+	size_t size() const { return x.size(); }
+
+	// one reading
+	double lookup(double sensorUnit) const
+	{
+		size_t s = lookupMode == Mode::Grid ? grid_section(sensorUnit) : eytzinger_section(sensorUnit);
+		return y[s] + slope[s] * (sensorUnit - x[s]);
+	}
+
+	// a batch of readings, out must be at least as long as in
+	void lookup(std::span<const double> in, std::span<double> out) const;
+
+    private:
+	Mode lookupMode{Mode::Eytzinger};
+	std::vector<double> x, y, slope;                // per section start: sensor unit, temperature, slope to the next breakpoint
+	std::vector<double> eytzinger;                  // sensor units in breadth first order, 1 based, [0] unused
+	std::vector<uint32_t> eytzingerIndex;           // sorted index of every Eytzinger slot
+	std::vector<uint32_t> grid;
+	double gridMin{0}, gridScale{0};
+
+	template<typename V>
+	size_t fill_eytzinger(const std::vector<BasicBreakPoint<V>> &bp, size_t i, size_t k);
+
+	// index of the section that holds sensorUnit: the last breakpoint <= sensorUnit, clamped to the sections
+	size_t eytzinger_section(double sensorUnit) const
+	{
+		const double *e = eytzinger.data();
+		size_t n = eytzinger.size() - 1;
+		size_t k = 1;
+		while(k <= n)
+		{
+			__builtin_prefetch(e + std::min(8 * k, n));
+			k = 2 * k + (e[k] <= sensorUnit);
+		}
+		k >>= __builtin_ffsll(~k);                  // slot of the first breakpoint > sensorUnit, 0 if there is none
+		size_t upper = k ? eytzingerIndex[k] : n;
+		return std::clamp<size_t>(upper, 1, x.size()) - 1;
+	}
+
+	// grid cell of a sensor unit, clamped to the grid while still a double: NaN, infinite and far off readings would overflow
+	// the conversion to size_t
+	size_t grid_cell(double sensorUnit) const
+	{
+		double c = (sensorUnit - gridMin) * gridScale;
+		if(!(c > 0))                                // below the grid, or NaN
+			return 0;
+		return c < grid.size() - 1 ? size_t(c) : grid.size() - 1;
+	}
+
+	size_t grid_section(double sensorUnit) const
+	{
+		size_t s = grid[grid_cell(sensorUnit)];
+		while(s + 1 < x.size() && x[s + 1] <= sensorUnit)
+			s++;
+		return s;
+	}
+};
+
+// place the sorted breakpoints bp[i...] in the Eytzinger subtree rooted at slot k, returns the next unused bp index
+template<typename V>
+size_t CurveLookup::fill_eytzinger(const std::vector<BasicBreakPoint<V>> &bp, size_t i, size_t k)
+{
+	if(k < eytzinger.size())
+	{
+		i = fill_eytzinger(bp, i, 2 * k);
+		eytzinger[k] = bp[i].sensorUnit;
+		eytzingerIndex[k] = i++;
+		i = fill_eytzinger(bp, i, 2 * k + 1);
+	}
+	return i;
+}
+
+/* Build the lookup tables from the breakpoints of a (reduced) curve, at least 2 of them in sensor unit order. gridCells = 0 gives
+ * 4 grid cells per breakpoint. */
+template<typename V>
+int CurveLookup::build(const std::vector<BasicBreakPoint<V>> &bp, Mode mode, size_t gridCells)
+{
+	size_t n = bp.size();
+	if(n < 2)
+		return -1;
+
+	lookupMode = mode;
+	x.assign(n - 1, 0);
+	y.assign(n - 1, 0);
+	slope.assign(n - 1, 0);
+	for(size_t s = 0; s + 1 < n; s++)
+	{
+		double dx = double(bp[s + 1].sensorUnit) - bp[s].sensorUnit;
+		x[s] = bp[s].sensorUnit;
+		y[s] = bp[s].temp;
+		slope[s] = dx > 0 ? (double(bp[s + 1].temp) - bp[s].temp) / dx : 0;
+	}
+
+	eytzinger.assign(n + 1, 0);
+	eytzingerIndex.assign(n + 1, 0);
+	fill_eytzinger(bp, 0, 1);
+
+	grid.clear();
+	if(mode == Mode::Grid)
+	{
+		size_t cells = gridCells ? gridCells : 4 * n;
+		double range = double(bp.back().sensorUnit) - bp.front().sensorUnit;
+		gridMin = bp.front().sensorUnit;
+		gridScale = range > 0 ? cells / range : 0;
+		grid.resize(cells);
+		// with the same cell calculation as grid_section(), every breakpoint in an earlier cell is below any reading of this cell
+		size_t s = 0;
+		for(size_t c = 0; c < cells; c++)
+		{
+			while(s + 1 < x.size() && grid_cell(x[s + 1]) < c)
+				s++;
+			grid[c] = s;
+		}
+	}
+
+	return 0;
+}
+
+void CurveLookup::lookup(std::span<const double> in, std::span<double> out) const
+{
+	size_t count = std::min(in.size(), out.size());
+	if(lookupMode == Mode::Grid)
+	{
+		for(size_t i = 0; i < count; i++)
+		{
+			size_t s = grid_section(in[i]);
+			out[i] = y[s] + slope[s] * (in[i] - x[s]);
+		}
+	}
+	else
+	{
+		for(size_t i = 0; i < count; i++)
+		{
+			size_t s = eytzinger_section(in[i]);
+			out[i] = y[s] + slope[s] * (in[i] - x[s]);
+		}
+	}
+}
+
+// How far a reduced curve strays from the original one, see ProcessCurve::verify_reduction()
+struct ReductionError
+{
+	double maxError{0};                             // largest interpolation error
+	double rmsError{0};                             // root mean square interpolation error over all original breakpoints
+	double worstSensorUnit{0};                      // where the largest error is
+	size_t worstIndex{0};                           // index of that original breakpoint
+	size_t numPoints{0};                            // original breakpoints compared
+};
+
+// How process_curve_BP() searches for the allowed slope deviation
+enum class SearchMode
+{
+	Linear,        // increase the deviation by DEVIATIONINC for each loop
+	Bisect         // bracket and bisect the deviation
+};
+
+// Which engine process_curve_BP() uses to reduce the breakpoints
+enum class ReduceEngine
+{
+	Deviation,     // merge adjacent section pairs under a global allowed deviation, searched by SearchMode
+	Greedy,        // remove the breakpoint with the smallest slope change one by one, hits the exact count
+	Optimal,       // dynamic programming, the smallest summed squared interpolation error, approximated on long curves
+	Legacy         // port of process_curve() of the C version, for comparisons
+};
+
+template<typename V>
+class BasicProcessCurve
+{
+    public:
+	using Point = BasicBreakPoint<V>;
+
+    private:
+	CurveArena arena;                               // storage of curveHDR and origCurveBP, reused by clear()
+	std::pmr::vector<std::pmr::string> curveHDR{&arena};
+	std::pmr::vector<Point> origCurveBP{&arena};
+	std::vector<Point> pickedCurveBP;
+	std::string fileName;
+	std::string outFileName;
+	bool verbose{true};
+	unsigned threads{0};                            // threads the parser and the optimal engine may use, 0 = one per core
+	SearchMode searchMode{SearchMode::Bisect};
+	ReduceEngine engine{ReduceEngine::Deviation};
+	bool exactOptimal{false};                       // the optimal engine tries every split point whatever the size
+	bool approximate{false};                        // pickIndex is from the approximate divide and conquer of the optimal engine
+
+	std::vector<double> sectionSlope;               // slope of the section from breakpoint i to i + 1
+	std::vector<double> slopeDelta;                 // slope deviation between the 2 sections at breakpoint i
+	std::vector<uint64_t> keepBits;                 // breakpoints whose slope deviation is above the allowed one
+	bool slopeTableValid{false};
+	std::vector<size_t> mergeOrder;                 // interior breakpoints in the order the greedy engine removes them
+	std::vector<double> mergeCost;                  // slope change of each removal
+	std::vector<double> mergeMaxCost;               // largest slope change up to each removal
+	std::vector<std::pair<size_t, size_t>> mergeSection;  // neighbours of each removed breakpoint, the section its removal leaves
+	bool hierarchyValid{false};
+	std::vector<size_t> mergePrev, mergeNext;       // work buffers of build_merge_hierarchy(), and of reduce_greedy()
+	IndexedMinHeap mergeHeap;
+	std::vector<size_t> pickIndex;                  // the reductions pick indices into origCurveBP
+	double boundError{-1};                          // >= 0 if pickIndex comes from reduce_error_bound() with this bound
+	size_t countTarget{0};                          // > 0 if it comes from reduce_to_count() with this count, SIZE_MAX: pick_all_BP()
+	std::vector<size_t> pickSeen;                   // its last breakpoint each pick and the picks before it depend on
+	std::vector<size_t> bestPickIndex, bestPickSeen;
+	std::vector<std::vector<Point>> chunkBP;   // breakpoints of each chunk of a file parsed in parallel
+
+	void build_slope_table();
+	size_t deviation_pass(double deviat);           // one merge pass with the allowed deviation, result on pickIndex
+	double max_slope_deviation();
+	int search_deviation_linear(size_t numOfBreakpoints, int &loops, double &deviation);
+	int search_deviation_bisect(size_t numOfBreakpoints, int &loops, double &deviation);
+	size_t legacy_pass(float deviat);
+	int reduce_legacy(size_t numOfBreakpoints, int &loops, double &deviation);
+	int reduce_with_engine(size_t numOfBreakpoints, int &loops, double &deviation);
+	double removal_cost(size_t prev, size_t mid, size_t next) const;
+	void build_merge_hierarchy();
+	void invalidate_tables() { slopeTableValid = hierarchyValid = false; }
+	void pick_from_index();
+	int repair_picks(size_t e, int change);
+	unsigned num_threads() const { return threads ? threads : std::max(1u, std::thread::hardware_concurrency()); }
+	int parse_breakpoints_parallel(std::string_view text, size_t numChunks);
+	int reduce_greedy(size_t numOfBreakpoints, double &deviation);
+	int reduce_optimal(size_t numOfBreakpoints, double &sqError);
+	int load_binary_curve(std::string_view data);
+	int save_binary_curve(const std::string &name, const std::vector<Point> &bp) const;
+	static std::string header_field(std::string_view hdr, size_t numBP);
+
+    public:
+	BasicProcessCurve() = default;
+	~BasicProcessCurve() = default;
+	BasicProcessCurve(const BasicProcessCurve &) = delete;
+	BasicProcessCurve &operator=(const BasicProcessCurve &) = delete;
+	void set_search_mode(SearchMode mode) { searchMode = mode; }
+	void set_engine(ReduceEngine e) { engine = e; }
+	void set_fileName(const std::string &name) { fileName = name; }
+	void set_output_file(const std::string &name) { outFileName = name; }
+	void set_verbose(bool v) { verbose = v; }
+	void set_threads(unsigned n) { threads = n; }
+	void set_exact_optimal(bool exact) { exactOptimal = exact; }
+	bool is_approximate() const { return approximate; }  // the last reduction is not guaranteed to be the optimum
+	size_t num_orig_BP() const { return origCurveBP.size(); }
+	size_t num_picked_BP() const { return pickedCurveBP.size(); }
+	const std::vector<Point> &picked_BP() const { return pickedCurveBP; }
+	size_t min_breakpoints() const;
+	void pick_all_BP();
+	void clear();
+	int insert_BP(double sensorUnit, double temp);  // edits of the curve, the picked breakpoints are brought up to date
+	int update_BP(size_t index, double sensorUnit, double temp);
+	int delete_BP(size_t index);
+        int print_BP() const;
+	int get_fileName();
+	int parse_curve_file();     // parse the curve file and pickout header field and breakpoint and store them on curveHDR and vector.
+	int validate_data();
+	int process_curve_BP();     // do calculation to see if wee need to merge breakpoints to reduce number of the breakpoints.
+	int reduce_to_count(size_t numOfBreakpoints, int &loops, double &deviation);
+	int process_curve_error_bound();                // pick breakpoints greedily so that the curve stays within an error bound.
+	int reduce_error_bound(double maxError);
+	int export_pareto(const std::string &name);     // K versus error of the greedy merge sequence, as CSV
+	int verify_reduction(ReductionError &err) const;  // interpolation error of pickedCurveBP against origCurveBP
+	void print_reduction_error() const;
+       	int save_processed_BP();    // save processed breakpoints and header into a file (binary if named *.crvb).
+};
+
+using ProcessCurve = BasicProcessCurve<double>;
+
+template<typename V>
+int BasicProcessCurve<V>::print_BP() const
+{
+	int count{ 0 };
+	//for(Point element : origCurveBP)
+	for(auto element : origCurveBP)
+	{
+		std::cout << "original BP: the " << count << " element - r is: " << element.sensorUnit << std::endl;
+		std::cout << "original BP: the " << count << " element - t is: " << element.temp << std::endl;
+		count++;
+	}
+
+	std::cout << std::endl;
+	count = 0;
+		
+	for(auto element : pickedCurveBP)
+	{
+		std::cout << "picked BP: the " << count << " element - sensorUnit " << element.sensorUnit << std::endl;
+		std::cout << "picked BP: the " << count << " element - temperature " << element.temp << std::endl;
+		count++;
+	}
+
+	return 0;
+}
+
+
+/* Parse the breakpoint lines of a breakpoint section into bp. Returns -1 at a line of wrong format, -2 at a value out of the range
+ * of V. */
+template<typename V>
+static int parse_breakpoint_lines(std::string_view text, std::vector<BasicBreakPoint<V>> &bp)
+{
+	bool bppstarted = true;
+	double r = 0, t = 0;
+
+	bp.clear();
+	bp.reserve(std::count(text.begin(), text.end(), '\n') + 1);
+	while(!text.empty())
+	{
+		size_t eol = text.find('\n');
+		std::string_view line = text.substr(0, eol);
+		text.remove_prefix(eol == std::string_view::npos ? text.size() : eol + 1);
+
+		CurveLine kind = parse_curve_line(line, bppstarted, r, t);
+		if(kind == CurveLine::BreakPoint && (!value_fits<V>(r) || !value_fits<V>(t)))
+		{
+			std::cerr << "Breakpoint out of the " << valueTypeName<V> << " range: " << line << std::endl;
+			return -2;
+		}
+		if(kind == CurveLine::BreakPoint)
+			bp.emplace_back(r, t);
+		else if(kind != CurveLine::Skip)
+			return -1;
+	}
+	return 0;
+}
+
+/* Parse the rest of a breakpoint section, split at newlines into numChunks chunks, on one thread per chunk into the chunk buffers.
+ * The chunks are then copied to the end of origCurveBP in order, again one thread per chunk. */
+template<typename V>
+int BasicProcessCurve<V>::parse_breakpoints_parallel(std::string_view text, size_t numChunks)
+{
+	std::vector<std::string_view> chunks;
+	std::vector<int> status(numChunks, 0);
+	std::vector<size_t> offset(numChunks + 1, origCurveBP.size());
+	std::vector<std::thread> workers;
+
+	for(size_t c = 0, start = 0; c < numChunks; c++)
+	{
+		size_t end = c + 1 == numChunks ? text.size() : text.find('\n', text.size() / numChunks * (c + 1));
+		end = end == std::string_view::npos ? text.size() : std::min(end + 1, text.size());
+		chunks.push_back(text.substr(start, end - start));
+		start = end;
+	}
+
+	if(chunkBP.size() < numChunks)
+		chunkBP.resize(numChunks);
+	for(size_t c = 1; c < numChunks; c++)
+		workers.emplace_back([&, c] { status[c] = parse_breakpoint_lines(chunks[c], chunkBP[c]); });
+	status[0] = parse_breakpoint_lines(chunks[0], chunkBP[0]);
+	for(auto &w : workers)
+		w.join();
+	workers.clear();
+
+	if(std::ranges::find(status, -1) != status.end())
+	{
+		std::cerr << "Wrong curve format!" << std::endl;
+		return -1;
+	}
+	if(std::ranges::find(status, -2) != status.end())
+		return -1;
+
+	for(size_t c = 0; c < numChunks; c++)
+		offset[c + 1] = offset[c] + chunkBP[c].size();
+	origCurveBP.resize(offset[numChunks], Point{0, 0});
+	for(size_t c = 1; c < numChunks; c++)
+		workers.emplace_back([&, c] { std::ranges::copy(chunkBP[c], origCurveBP.begin() + offset[c]); });
+	std::ranges::copy(chunkBP[0], origCurveBP.begin() + offset[0]);
+	for(auto &w : workers)
+		w.join();
+
+	return 0;
+}
+
+/* Parse curve file and pickout all the breakpoints to prepare for further process. A binary curve file is loaded directly.
+ * The file is memory mapped and walked line by line with std::string_view, numbers are converted with std::from_chars and
+ * origCurveBP is reserved from the number of lines, so nothing is allocated per breakpoint line.
+ * Once the header is done, a big breakpoint section is split into chunks that are parsed in parallel. */
+template<typename V>
+int BasicProcessCurve<V>::parse_curve_file()
+{
+	bool bppstarted = false;    // if breakpoint process has started or not 
+	MappedFile mf;
+	double r = 0, t = 0;
+	StageTimer timer(StageParse);
+
+    	dprintf("ProcessCurv::parse_curve_file() is called.\n");
+
+    	// map the file for read
+	if(mf.open(fileName) < 0)
+    	{
+    		std::cerr << "Unable to open file: " << fileName << std::endl;
+    		return -1;
+   	}
+
+	invalidate_tables();
+	std::string_view text = mf.view();
+	if(is_binary_curve(text))
+		return load_binary_curve(text);
+	METRIC_ADD(lines, std::count(text.begin(), text.end(), '\n') + !text.ends_with('\n'));
+
+	size_t numChunks = std::min<size_t>(num_threads(), text.size() / PARSECHUNKMIN);
+	if(numChunks <= 1)
+		origCurveBP.reserve(origCurveBP.size() + std::count(text.begin(), text.end(), '\n') + 1);
+
+   	// read and process the curve file
+	while(!text.empty())
+	{
+		if(bppstarted && numChunks > 1)
+			return parse_breakpoints_parallel(text, numChunks);
+
+		size_t eol = text.find('\n');
+		std::string_view line = text.substr(0, eol);
+		text.remove_prefix(eol == std::string_view::npos ? text.size() : eol + 1);
+
+		switch(parse_curve_line(line, bppstarted, r, t))
+		{
+		case CurveLine::Header:
+			/* we do not need to process header in this program, and just push all header fields into the vector. */
+			if(line.ends_with('\r'))
+				line.remove_suffix(1);
+			curveHDR.emplace_back(line);
+			break;
+		case CurveLine::BreakPoint:
+			if(!value_fits<V>(r) || !value_fits<V>(t))
+			{
+				std::cerr << "Breakpoint out of the " << valueTypeName<V> << " range: " << line << std::endl;
+				return -1;
+			}
+			origCurveBP.emplace_back(r, t);
+			break;
+		case CurveLine::Error:
+			std::cerr << "Wrong curve format!" << std::endl;
+			return -1;
+		case CurveLine::Skip:
+			break;
+		}
+	}
+
+	dprintf("DEBUGG:::===> Process curve file is done. Number of BPs is: %ld\n", origCurveBP.size());
+
+	return 0;
+}
+
+template<typename V>
+int BasicProcessCurve<V>::get_fileName()
+{
+	std::cout << "Enter the curve file name you want to process: " << std::endl;
+	std::getline(std::cin >> std::ws, fileName);
+	if(!std::filesystem::exists(fileName))
+	{
+		std::cout << "File: " << fileName << " dose not exist!" << std::endl;
+		return -1;
+	}
+	else
+		std::cout << "OK, file: " << fileName << " exist!" << std::endl;
+
+   	// convert std string into C string:
+   	printf("Covert fileName from STD string to C string: %s\n", fileName.c_str());
+	
+   	return 0;
+}
+
+
+/* The sensor units have to be in ascending order. A big curve is checked in chunks on several threads, each chunk includes the
+ * first breakpoint of the next one, so the pairs across the chunk boundaries are checked too. */
+template<typename V>
+int BasicProcessCurve<V>::validate_data(){
+
+	auto checkSeq{
+		[](const Point& a, const Point& b)
+		{
+			return (a.sensorUnit  > b.sensorUnit); 
+		}
+	};
+
+	StageTimer timer(StageValidate);
+
+	if(!origCurveBP.empty()){
+		size_t n = origCurveBP.size();
+		size_t numChunks = std::max<size_t>(1, std::min<size_t>(num_threads(), n / VALIDATECHUNKMIN));
+		std::vector<char> wrong(numChunks, 0);
+		std::vector<std::thread> workers;
+		auto check{
+			[&](size_t c)
+			{
+				auto first = origCurveBP.begin() + n / numChunks * c;
+				auto last = c + 1 == numChunks ? origCurveBP.end() : origCurveBP.begin() + n / numChunks * (c + 1) + 1;
+				wrong[c] = std::adjacent_find(first, last, checkSeq) != last;
+			}
+		};
+
+		for(size_t c = 1; c < numChunks; c++)
+			workers.emplace_back(check, c);
+		check(0);
+		for(auto &w : workers)
+			w.join();
+
+		if(std::ranges::find(wrong, 1) != wrong.end()){
+			std::cerr << "File error: " << fileName << '\n';
+			return -1;
+		}
+		else if(verbose)
+			std::cout << "Validation passed!" << '\n';
+	}
+	return 0;
+}
+
+/* Calculate the section slopes and the slope deviation at every breakpoint once, the merge passes only compare them. */
+template<typename V>
+void BasicProcessCurve<V>::build_slope_table()
+{
+	size_t n = origCurveBP.size();
+
+	sectionSlope.resize(n);
+	slopeDelta.assign(n, 0);
+	keepBits.resize((n + 63) / 64);
+	slopeKernels<V>.slope(origCurveBP.data(), n, sectionSlope.data(), slopeDelta.data());
+	slopeTableValid = true;
+}
+
+/* Run one merge pass over origCurveBP with the given allowed slope deviation and fill pickIndex with the indices of the
+ * breakpoints that survive. Returns the number of breakpoints picked out.
+ * The pass looks at the two sections around breakpoint m: if their slope deviation is bigger than the allowed one, m is picked
+ * and the next pair is the one around m + 1. Otherwise the 2 sections are merged, m + 1 (the end of the second section) is picked
+ * and the next pair is the one around m + 2. The deviations come from the slope table and are compared with the allowed one by
+ * the vectorised threshold kernel, which leaves only this walk over the keep bits. */
+template<typename V>
+size_t BasicProcessCurve<V>::deviation_pass(double deviat)
+{
+	size_t n = origCurveBP.size();
+
+	if(!slopeTableValid)
+		build_slope_table();
+	slopeKernels<V>.threshold(slopeDelta.data(), n, deviat, keepBits.data());
+
+	pickIndex.clear();
+	pickIndex.push_back(0);                       // [0], the first BP should always be picked.
+
+	// at least there are 3 breakpoints
+	size_t m = 1;
+	while(1)
+	{
+		if(keepBits[m / 64] >> (m % 64) & 1)
+		{   // can not merge this 2 sections
+			pickIndex.push_back(m);
+			if(m + 2 < n)
+			{
+				m++;
+				continue;
+			}
+			pickIndex.push_back(m + 1);           // reached end
+			break;
+		}
+		else
+		{   // can merge this 2 sectons
+			pickIndex.push_back(m + 1);
+			if(m + 3 < n)
+			{
+				m += 2;
+				continue;
+			}
+			if(m + 2 < n)
+				pickIndex.push_back(m + 2);       // reached end
+			break;
+		}
+	}
+
+	dprintf("DEBUG :::: pickIndex size() = %ld\n", pickIndex.size());
+	METRIC_ADD(merges, n - pickIndex.size());
+
+	return pickIndex.size();
+}
+
+/* Copy the breakpoints picked out by their indices into pickedCurveBP, once per reduction. */
+template<typename V>
+void BasicProcessCurve<V>::pick_from_index()
+{
+	pickedCurveBP.resize(pickIndex.size(), Point{0, 0});
+	for(size_t i = 0; i < pickIndex.size(); i++)
+		pickedCurveBP[i] = origCurveBP[pickIndex[i]];
+}
+
+/* The largest finite slope deviation between two adjacent sections. A pass run with this deviation merges every
+ * section pair it visits, so it is the upper end of the bracket for the bisection search. */
+template<typename V>
+double BasicProcessCurve<V>::max_slope_deviation()
+{
+	double maxDelta = 0;
+
+	if(!slopeTableValid)
+		build_slope_table();
+	for(size_t i = 1; i + 1 < origCurveBP.size(); i++)
+		if(std::isfinite(slopeDelta[i]) && slopeDelta[i] > maxDelta)
+			maxDelta = slopeDelta[i];
+	return maxDelta;
+}
+
+/* Linear search: start from deviation 0 and increase it by DEVIATIONINC until the number of picked out breakpoints fits. */
+template<typename V>
+int BasicProcessCurve<V>::search_deviation_linear(size_t numOfBreakpoints, int &loops, double &deviation)
+{
+	float deviat = 0;               
+	size_t numPickedBP = 0;
+
+	while(1)
+	{
+		loops++;
+		dprintf("DEBUGG::: 2 =====> LOOP: %d; %s\n", loops, " +++++++++++++");
+		deviation_pass(deviat);
+
+		if(numPickedBP == pickIndex.size())
+		{
+			pick_from_index();
+			return -1;
+		}
+		else
+			numPickedBP = pickIndex.size();
+
+		/* now the curve is processed with an allowed deviation, we check to see how many breakpoints have been picked out. If it is still 
+		 * too many than the user wanted, we increase the allowed deviation and continue to process.
+		 * if the number of picked out breakpoint is equal or smaller than the user wanted, then we stop loop and problem solved. */
+		if(pickIndex.size() <= numOfBreakpoints)
+			break;
+
+		deviat += DEVIATIONINC;     // If there are still too many breakpoints, we increase the allowed deviation gradually
+		dprintf("Change Deviation to ==>:: %f for next loop\n", deviat);
+	}
+
+	pick_from_index();
+	deviation = deviat;
+	return 0;
+}
+
+/* Bisection search: bracket the allowed deviation by doubling it (capped by the largest slope deviation of the curve), then
+ * bisect the bracket until it is narrower than DEVIATIONEPS (relative). The smallest deviation found that meets the requested
+ * number of breakpoints is reported, and pickedCurveBP holds the breakpoints picked out with it.
+ * The number of picked out breakpoints is not strictly monotone in the deviation (a merge shifts the pairing of the following
+ * sections), so the result is the smallest deviation on the bisection path, not necessarily the global smallest one. */
+template<typename V>
+int BasicProcessCurve<V>::search_deviation_bisect(size_t numOfBreakpoints, int &loops, double &deviation)
+{
+	double lo = 0, hi = 0;
+	double maxDelta = max_slope_deviation();
+
+	loops++;
+	if(deviation_pass(0) <= numOfBreakpoints)
+	{
+		pick_from_index();
+		deviation = 0;
+		return 0;
+	}
+
+	// bracket: lo does not fit, hi fits
+	hi = std::min(DEVIATIONINC, maxDelta);
+	while(1)
+	{
+		loops++;
+		if(deviation_pass(hi) <= numOfBreakpoints)
+			break;
+		if(hi >= maxDelta)
+		{
+			pick_from_index();
+			return -1;                                  // even merging every section pair visited is not enough
+		}
+		lo = hi;
+		hi = std::min(hi * 2, maxDelta);
+	}
+	bestPickIndex.swap(pickIndex);
+
+	// bisect
+	while(hi - lo > DEVIATIONEPS * std::max(1.0, hi))
+	{
+		double mid = lo + (hi - lo) / 2;
+		loops++;
+		dprintf("DEBUGG::: 2 =====> LOOP: %d; lo = %f, hi = %f\n", loops, lo, hi);
+		if(deviation_pass(mid) <= numOfBreakpoints)
+		{
+			hi = mid;
+			bestPickIndex.swap(pickIndex);
+		}
+		else
+			lo = mid;
+	}
+
+	pickIndex.swap(bestPickIndex);
+	pick_from_index();
+	deviation = hi;
+	return 0;
+}
+
+/* One pass of process_curve() of the C version over origCurveBP, result on pickIndex. Unlike deviation_pass() the first section
+ * of a pair is not moved on when the pair is merged: the following sections are compared with it until one deviates by deviat or
+ * more, and the start of that one is picked. A pair of an ascending and a descending section always picks the breakpoint between
+ * them, and the slopes are compared as absolute values. A slope deviation that is not a number (sections of zero width) picks
+ * the breakpoint, the C version loops forever on it. */
+template<typename V>
+size_t BasicProcessCurve<V>::legacy_pass(float deviat)
+{
+	size_t n = origCurveBP.size();
+	const Point *bp = origCurveBP.data();
+	size_t start1 = 0, end1 = 1, start2 = 1, end2 = 2;
+
+	pickIndex.clear();
+	pickIndex.push_back(0);                       // first BP always ok
+	while(1)
+	{
+		if(end2 >= n)
+		{   // reached the end of the curve
+			pickIndex.push_back(start2);
+			break;
+		}
+
+		double rise1 = double(bp[end1].temp) - bp[start1].temp, rise2 = double(bp[end2].temp) - bp[start2].temp;
+		if((rise1 >= 0) != (rise2 >= 0))
+		{   // one section ascending and the other descending, start a new pair at the start of the second one
+			pickIndex.push_back(start2);
+			start1 = start2;
+			end1 = start2 = start1 + 1;
+			end2 = start2 + 1;
+			continue;
+		}
+
+		double tang1 = fabs(rise1) / (double(bp[end1].sensorUnit) - bp[start1].sensorUnit);
+		double tang2 = fabs(rise2) / (double(bp[end2].sensorUnit) - bp[start2].sensorUnit);
+		double deltT = fabs(tang2 - tang1);
+		if(deltT < deviat)
+		{   // smooth enough, compare the next section with the first one
+			start2 = end2;
+			end2 = start2 + 1;
+		}
+		else
+		{   // pick the start of the second section and use it as the new start point
+			pickIndex.push_back(start2);
+			start1 = start2;
+			end1 = start2 = start1 + 1;
+			end2 = start2 + 1;
+		}
+	}
+
+	METRIC_ADD(merges, n - pickIndex.size());
+	return pickIndex.size();
+}
+
+/* Legacy engine: the search of the C process_curve(), the allowed deviation starts from 0 and grows by LEGACYDEVIATIONINC (a
+ * float, like in C) until the count fits. The C version loops forever when the count can not be reached, here the search gives
+ * up once the deviation is above every slope of the curve or the float no longer grows. */
+template<typename V>
+int BasicProcessCurve<V>::reduce_legacy(size_t numOfBreakpoints, int &loops, double &deviation)
+{
+	float deviat = 0;
+	double maxSlope = 0;
+
+	for(size_t i = 0; i + 1 < origCurveBP.size(); i++)
+	{
+		double slope = fabs((double(origCurveBP[i + 1].temp) - origCurveBP[i].temp)
+				    / (double(origCurveBP[i + 1].sensorUnit) - origCurveBP[i].sensorUnit));
+		if(std::isfinite(slope))
+			maxSlope = std::max(maxSlope, slope);
+	}
+
+	while(1)
+	{
+		loops++;
+		if(legacy_pass(deviat) <= numOfBreakpoints)
+			break;
+
+		float next = deviat + (float)LEGACYDEVIATIONINC;
+		if(deviat > maxSlope || next == deviat)
+		{
+			pick_from_index();
+			return -1;
+		}
+		deviat = next;
+	}
+
+	pick_from_index();
+	deviation = deviat;
+	return 0;
+}
+
+/* Slope change caused by removing breakpoint mid, the section prev-mid and the section mid-next are replaced by prev-next.
+ * It is the same deltT the deviation pass compares, a NaN (sections of zero width) is taken as 0 like the pass merges them. */
+template<typename V>
+double BasicProcessCurve<V>::removal_cost(size_t prev, size_t mid, size_t next) const
+{
+	const Point &a = origCurveBP[prev], &b = origCurveBP[mid], &c = origCurveBP[next];
+	double tang1 = (double(b.temp) - a.temp) / (double(b.sensorUnit) - a.sensorUnit);
+	double tang2 = (double(c.temp) - b.temp) / (double(c.sensorUnit) - b.sensorUnit);
+	double deltT = fabs(tang1 - tang2);
+	return std::isnan(deltT) ? 0 : deltT;
+}
+
+/* Record the whole merge sequence of the greedy engine once: keep every interior breakpoint on an indexed min-heap keyed by the
+ * slope change its removal causes, remove the cheapest one and update the cost of its two neighbours only, until only the 2 end
+ * points are left. mergeOrder holds the removed breakpoints in order, so the n - K first ones are exactly those the greedy engine
+ * removes to get down to K, for any K. One O(n log n) pass. */
+template<typename V>
+void BasicProcessCurve<V>::build_merge_hierarchy()
+{
+	size_t vsize = origCurveBP.size();
+	std::vector<size_t> &prev = mergePrev, &next = mergeNext;
+	IndexedMinHeap &heap = mergeHeap;
+	double maxCost = 0;
+
+	prev.resize(vsize);
+	next.resize(vsize);
+	heap.reset(vsize);
+	mergeOrder.clear();
+	mergeCost.clear();
+	mergeMaxCost.clear();
+	mergeSection.clear();
+	mergeOrder.reserve(vsize);
+	mergeCost.reserve(vsize);
+	mergeMaxCost.reserve(vsize);
+	mergeSection.reserve(vsize);
+
+	for(size_t i = 0; i < vsize; i++)
+	{
+		prev[i] = i - 1;                             // wraps for i = 0, never used
+		next[i] = i + 1;
+	}
+	for(size_t i = 1; i + 1 < vsize; i++)
+		heap.push(i, removal_cost(i - 1, i, i + 1));
+
+	while(!heap.empty())
+	{
+		double cost = heap.top_key();
+		size_t mid = heap.pop();
+		size_t p = prev[mid], n = next[mid];
+		dprintf("DEBUG::: greedy removes %ld, cost = %f\n", mid, cost);
+
+		maxCost = std::max(maxCost, cost);
+		mergeOrder.push_back(mid);
+		mergeCost.push_back(cost);
+		mergeMaxCost.push_back(maxCost);
+		mergeSection.emplace_back(p, n);
+
+		next[p] = n;
+		prev[n] = p;
+
+		if(heap.contains(p))
+			heap.update(p, removal_cost(prev[p], p, n));
+		if(heap.contains(n))
+			heap.update(n, removal_cost(p, n, next[n]));
+	}
+	METRIC_ADD(merges, mergeOrder.size());
+
+	hierarchyValid = true;
+}
+
+/* Greedy merge engine: remove the breakpoint with the smallest slope change one at a time until exactly numOfBreakpoints are
+ * left. The merge sequence is recorded once, after that any count is picked out of it in O(K) without recomputation. */
+template<typename V>
+int BasicProcessCurve<V>::reduce_greedy(size_t numOfBreakpoints, double &deviation)
+{
+	size_t vsize = origCurveBP.size();
+
+	if(numOfBreakpoints < 2)
+		numOfBreakpoints = 2;                        // the first and the last breakpoints are always kept
+	if(numOfBreakpoints > vsize)
+		numOfBreakpoints = vsize;
+	if(!hierarchyValid)
+		build_merge_hierarchy();
+
+	// the survivors are the 2 end points and the breakpoints removed in the last K - 2 steps: undo those steps from the last one,
+	// each puts its breakpoint back between the neighbours it had, then walk the list of survivors in order
+	size_t removed = vsize - numOfBreakpoints;
+	std::vector<size_t> &next = mergeNext;
+	deviation = removed ? mergeMaxCost[removed - 1] : 0;
+
+	next[0] = vsize - 1;
+	for(size_t s = mergeOrder.size(); s-- > removed; )
+	{
+		next[mergeSection[s].first] = mergeOrder[s];
+		next[mergeOrder[s]] = mergeSection[s].second;
+	}
+	pickIndex.clear();
+	for(size_t i = 0; i != vsize - 1; i = next[i])
+		pickIndex.push_back(i);
+	pickIndex.push_back(vsize - 1);
+	pick_from_index();
+
+	return 0;
+}
+
+/* Export the K versus error Pareto curve of the greedy merge sequence as CSV: for every number of breakpoints K from n down to 2,
+ * the slope change of the merge that leads to K, the largest slope change so far and the max and rms interpolation error of the
+ * K breakpoint curve against all the original breakpoints, as verify_reduction() measures it. The merges are replayed with the
+ * error of every section kept: a merge only replaces its 2 sections by one, whose error is measured over the original breakpoints
+ * it spans, the largest section error comes from a max-heap whose stale entries are dropped when they come to the top. That is
+ * the length of every merged section, O(n log n) when the merges are spread over the curve, up to O(n^2) in the worst case. */
+template<typename V>
+int BasicProcessCurve<V>::export_pareto(const std::string &name)
+{
+	size_t vsize = origCurveBP.size();
+	if(vsize < 3)
+		return -1;
+	if(!hierarchyValid)
+		build_merge_hierarchy();
+
+	std::ofstream outf{name.c_str()};
+	if(!outf)
+	{
+		std::cerr << "Unable to open file: " << name << std::endl;
+		return -1;
+	}
+
+	// error of the section that starts at each breakpoint, it ends at sectionEnd
+	std::vector<double> sectionMax(vsize, 0), sectionSq(vsize, 0);
+	std::vector<size_t> sectionEnd(vsize);
+	std::iota(sectionEnd.begin(), sectionEnd.end(), 1);
+	std::priority_queue<std::pair<double, size_t>> largest;     // (max error, section start), stale once the section changed
+	double sumSq = 0;
+
+	char line[160];
+	outf << "breakpoints,slope_change,max_slope_change,max_error,rms_error\n";
+	outf << vsize << ",0,0,0,0\n";
+	for(size_t s = 0; s < mergeOrder.size(); s++)
+	{
+		auto [p, n] = mergeSection[s];
+		const Point &a = origCurveBP[p], &b = origCurveBP[n];
+		double dx = double(b.sensorUnit) - a.sensorUnit;
+		double slope = dx > 0 ? (double(b.temp) - a.temp) / dx : 0;
+		double segMax = 0, segSq = 0;
+		slopeKernels<V>.error(&origCurveBP[p + 1], n - p - 1, a.sensorUnit, a.temp, slope, segMax, segSq);
+
+		sumSq += segSq - sectionSq[p] - sectionSq[mergeOrder[s]];
+		sectionMax[p] = segMax;
+		sectionSq[p] = segSq;
+		sectionEnd[p] = n;
+		sectionEnd[mergeOrder[s]] = 0;              // no section starts there any more
+		largest.emplace(segMax, p);
+		while(sectionMax[largest.top().second] != largest.top().first || sectionEnd[largest.top().second] == 0)
+			largest.pop();
+
+		snprintf(line, sizeof(line), "%ld,%.10g,%.10g,%.10g,%.10g\n", vsize - 1 - s, mergeCost[s], mergeMaxCost[s], largest.top().first,
+			 std::sqrt(std::max(sumSq, 0.0) / vsize));
+		outf << line;
+	}
+
+	if(!outf)
+	{
+		std::cerr << "Error write to file: " << name << std::endl;
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Prefix sums over the (centred) breakpoints, so that the summed squared error of the chord from breakpoint i to breakpoint j
+ * against all original breakpoints in between can be calculated in O(1).
+ */
+struct SegmentErrorTable
+{
+	std::vector<double> sx, sy, sxx, syy, sxy;
+	std::vector<double> x, y;
+
+	template<typename V>
+	explicit SegmentErrorTable(std::span<const BasicBreakPoint<V>> bp)
+	{
+		size_t n = bp.size();
+		double mx = 0, my = 0;
+		for(auto &p : bp)
+		{
+			mx += p.sensorUnit;
+			my += p.temp;
+		}
+		mx /= n;
+		my /= n;
+
+		x.resize(n);
+		y.resize(n);
+		sx.assign(n + 1, 0);
+		sy.assign(n + 1, 0);
+		sxx.assign(n + 1, 0);
+		syy.assign(n + 1, 0);
+		sxy.assign(n + 1, 0);
+		for(size_t k = 0; k < n; k++)
+		{
+			x[k] = bp[k].sensorUnit - mx;         // centred to keep the prefix sums well conditioned
+			y[k] = bp[k].temp - my;
+			sx[k + 1] = sx[k] + x[k];
+			sy[k + 1] = sy[k] + y[k];
+			sxx[k + 1] = sxx[k] + x[k] * x[k];
+			syy[k + 1] = syy[k] + y[k] * y[k];
+			sxy[k + 1] = sxy[k] + x[k] * y[k];
+		}
+	}
+
+	// sum of (y - a - s * x)^2 over breakpoints i..j, where y = a + s * x is the chord through breakpoint i and breakpoint j
+	double cost(size_t i, size_t j) const
+	{
+		if(j <= i + 1)
+			return 0;
+		double dx = x[j] - x[i];
+		if(dx == 0)
+			return std::numeric_limits<double>::infinity();
+		double s = (y[j] - y[i]) / dx;
+		double a = y[i] - s * x[i];
+		double m = j - i + 1;
+		double Sx = sx[j + 1] - sx[i], Sy = sy[j + 1] - sy[i];
+		double Sxx = sxx[j + 1] - sxx[i], Syy = syy[j + 1] - syy[i], Sxy = sxy[j + 1] - sxy[i];
+		double e = Syy - 2 * a * Sy - 2 * s * Sxy + m * a * a + 2 * a * s * Sx + s * s * Sxx;
+		return e > 0 ? e : 0;
+	}
+};
+
+/* Fill cur[l..r] from prev with the divide and conquer optimisation: the best split point of the middle breakpoint bounds the
+ * split points of the two halves. The two halves are independent and are run on their own threads for the first depth levels. */
+static void dp_layer(const SegmentErrorTable &tbl, const std::vector<double> &prev, std::vector<double> &cur,
+		     std::vector<uint32_t> &arg, size_t l, size_t r, size_t optl, size_t optr, int depth)
+{
+	if(l > r)
+		return;
+
+	size_t mid = l + (r - l) / 2;
+	double best = std::numeric_limits<double>::infinity();
+	size_t bestI = optl;
+	for(size_t i = optl; i <= std::min(optr, mid - 1); i++)
+	{
+		double v = prev[i] + tbl.cost(i, mid);
+		if(v < best)
+		{
+			best = v;
+			bestI = i;
+		}
+	}
+	cur[mid] = best;
+	arg[mid] = bestI;
+
+	if(depth > 0)
+	{
+		std::thread left;
+		if(mid > l)
+			left = std::thread(dp_layer, std::cref(tbl), std::cref(prev), std::ref(cur), std::ref(arg), l, mid - 1, optl, bestI, depth - 1);
+		dp_layer(tbl, prev, cur, arg, mid + 1, r, bestI, optr, depth - 1);
+		if(left.joinable())
+			left.join();
+	}
+	else
+	{
+		if(mid > l)
+			dp_layer(tbl, prev, cur, arg, l, mid - 1, optl, bestI, 0);
+		dp_layer(tbl, prev, cur, arg, mid + 1, r, bestI, optr, 0);
+	}
+}
+
+/* Fill cur[l..r] from prev by trying every split point, the j range is cut into one slice per thread. */
+static void dp_layer_exact(const SegmentErrorTable &tbl, const std::vector<double> &prev, std::vector<double> &cur,
+			   std::vector<uint32_t> &arg, size_t l, size_t r, size_t optl, unsigned threads)
+{
+	auto slice{
+		[&](size_t from, size_t to)
+		{
+			for(size_t j = from; j <= to; j++)
+			{
+				double best = std::numeric_limits<double>::infinity();
+				size_t bestI = optl;
+				for(size_t i = optl; i < j; i++)
+				{
+					double v = prev[i] + tbl.cost(i, j);
+					if(v < best)
+					{
+						best = v;
+						bestI = i;
+					}
+				}
+				cur[j] = best;
+				arg[j] = bestI;
+			}
+		}
+	};
+
+	if(threads <= 1 || r - l < 64)
+	{
+		slice(l, r);
+		return;
+	}
+
+	// later j try more split points, so cut the range into slices of about equal work instead of equal length
+	std::vector<std::thread> workers;
+	double total = (double)(r - optl) * (r - optl) - (double)(l - optl) * (l - optl);
+	size_t from = l;
+	for(unsigned t = 1; t <= threads && from <= r; t++)
+	{
+		size_t to = r;
+		if(t < threads)
+		{
+			double edge = std::sqrt((double)(l - optl) * (l - optl) + total * t / threads);
+			to = std::clamp(optl + (size_t)edge, from, r);
+		}
+		workers.emplace_back(slice, from, to);
+		from = to + 1;
+	}
+	for(auto &w : workers)
+		w.join();
+}
+
+/* Optimal engine: pick the numOfBreakpoints breakpoints (the first and the last always included) that minimise the summed squared
+ * interpolation error against all the original breakpoints, by dynamic programming over the number of breakpoints:
+ *
+ *     err[k][j] = min over i < j of err[k-1][i] + cost(i, j)
+ *
+ * cost() is O(1) from prefix sums. When K * n^2 / 2 is within OPTIMALEXACTLIMIT, or set_exact_optimal() asks for it, every split
+ * point is tried and the result is the exact optimum. Larger curves are solved with the divide and conquer optimisation in
+ * O(n log n) per layer, O(K n log n) in total. That assumes the best split point is monotone in j, which this cost does not
+ * guarantee (noisy curves of 2500 points reduced to 100 came out up to 17% above the optimum), so the result is only an
+ * approximation: is_approximate() reports it and the reports name it OPTIMALAPPROXNAME, not optimal. Either way a layer is
+ * spread over the available cores. */
+template<typename V>
+int BasicProcessCurve<V>::reduce_optimal(size_t numOfBreakpoints, double &sqError)
+{
+	size_t vsize = origCurveBP.size();
+	const double inf = std::numeric_limits<double>::infinity();
+	SegmentErrorTable tbl{std::span<const Point>(origCurveBP)};
+	std::vector<double> prev(vsize, inf), cur(vsize, inf);
+	std::vector<std::vector<uint32_t>> arg;
+	int depth = 0;
+
+	if(numOfBreakpoints < 2)
+		numOfBreakpoints = 2;
+	if(numOfBreakpoints > vsize)
+		numOfBreakpoints = vsize;
+
+	unsigned threads = num_threads();
+	for(unsigned t = threads; t > 1; t /= 2)
+		depth++;
+	bool exact = exactOptimal || (double)numOfBreakpoints * vsize * vsize / 2 <= OPTIMALEXACTLIMIT;
+	approximate = !exact;
+
+	// layer 1: only breakpoint 0 is picked
+	prev[0] = 0;
+	arg.assign(numOfBreakpoints, std::vector<uint32_t>());
+	for(size_t k = 2; k <= numOfBreakpoints; k++)
+	{
+		// with k breakpoints the last one is at least at index k - 1
+		arg[k - 1].assign(vsize, 0);
+		std::fill(cur.begin(), cur.end(), inf);
+		if(exact)
+			dp_layer_exact(tbl, prev, cur, arg[k - 1], k - 1, vsize - 1, k - 2, threads);
+		else
+			dp_layer(tbl, prev, cur, arg[k - 1], k - 1, vsize - 1, k - 2, vsize - 2, depth);
+		prev.swap(cur);
+	}
+	sqError = prev[vsize - 1];
+
+	// walk the split points back from the last breakpoint
+	pickIndex.resize(numOfBreakpoints);
+	size_t j = vsize - 1;
+	for(size_t k = numOfBreakpoints; k >= 1; k--)
+	{
+		pickIndex[k - 1] = j;
+		if(k > 1)
+			j = arg[k - 1][j];
+	}
+
+	pick_from_index();
+
+	return 0;
+}
+
+/* The number can not be reduced to less than the following by the deviation engine:
+ *  NumberOfBPs / 2 + 1
+ *  If we have 31 BPs,   we got 31/2 + 2 = 17
+ * The greedy and the optimal engines pick any number of breakpoints and can go down to the 2 end points. */
+template<typename V>
+size_t BasicProcessCurve<V>::min_breakpoints() const
+{
+	if(engine == ReduceEngine::Deviation)
+		return origCurveBP.size() / 2 + 2;
+	return 2;
+}
+
+/* Reduce the breakpoints to numOfBreakpoints with the selected engine, without any prompt.
+ * Returns 0 when done, 1 if the curve already has few enough breakpoints (all of them are picked), -1 if the engine could not
+ * get down to numOfBreakpoints and -2 if the curve or numOfBreakpoints is invalid. */
+template<typename V>
+int BasicProcessCurve<V>::reduce_to_count(size_t numOfBreakpoints, int &loops, double &deviation)
+{
+	StageTimer timer(StageReduce);
+	int ret = reduce_with_engine(numOfBreakpoints, loops, deviation);
+	countTarget = ret == 1 ? SIZE_MAX : std::max<size_t>(numOfBreakpoints, 1);   // what an edit reduces to again
+
+	METRIC_ADD(passes, loops);
+	if(ret >= 0)
+	{
+		METRIC_ADD(bpIn, origCurveBP.size());
+		METRIC_ADD(bpOut, pickedCurveBP.size());
+	}
+	return ret;
+}
+
+template<typename V>
+int BasicProcessCurve<V>::reduce_with_engine(size_t numOfBreakpoints, int &loops, double &deviation)
+{
+	loops = 0;
+	boundError = -1;
+	approximate = false;
+	deviation = 0;
+
+	if(origCurveBP.size() < 3 || numOfBreakpoints < min_breakpoints())
+		return -2;
+
+	if(numOfBreakpoints > origCurveBP.size())
+	{
+		pick_all_BP();
+		return 1;
+	}
+
+	dprintf("DEBUG::: 1 =====> size of origCurveBP: %ld\n", origCurveBP.size());
+
+	if(engine == ReduceEngine::Greedy)
+	{
+		loops = 1;
+		return reduce_greedy(numOfBreakpoints, deviation);
+	}
+	else if(engine == ReduceEngine::Optimal)
+	{
+		loops = 1;
+		return reduce_optimal(numOfBreakpoints, deviation);
+	}
+	else if(engine == ReduceEngine::Legacy)
+		return reduce_legacy(numOfBreakpoints, loops, deviation);
+	else if(searchMode == SearchMode::Linear)
+		return search_deviation_linear(numOfBreakpoints, loops, deviation);
+	else
+		return search_deviation_bisect(numOfBreakpoints, loops, deviation);
+}
+
+template<typename V>
+int BasicProcessCurve<V>::process_curve_BP()
+{
+	std::string numBPs;
+	size_t numOfBreakpoints;
+	int loops = 0;
+	double deviation = 0;
+	int ret;
+
+	int vsize = origCurveBP.size();
+	if(vsize < 3)
+	{
+		std::cout << "Too few break points!" << std::endl;
+		return -1;
+	} 
+
+try_again:
+
+	std::cout << "How many break points you want to have/keep?" << std::endl;
+	std::getline(std::cin >> std::ws, numBPs);
+	numOfBreakpoints = atoi(numBPs.c_str());
+	// we control the number fall in between 20 - 200;
+
+	if(numOfBreakpoints < min_breakpoints())
+	{
+		std::cout << "Number of breakpoints should not less than " << min_breakpoints() <<  std::endl;
+		goto try_again;
+	}
+
+	ret = reduce_to_count(numOfBreakpoints, loops, deviation);
+	if(ret == 1)
+	{
+		std::cout << "Curve breakpoints is OK, no need to do further process!" << std::endl;
+		return 1;
+	}
+	if(ret < 0)
+	{
+		std::cout << "Unable to reduce the breakpoints to " << numOfBreakpoints << ", " << pickedCurveBP.size() << " picked out after " 
+			  << loops << " loops." << std::endl;
+		return 0;
+	}
+
+	printf("\n\n\n################################################################################################\n");
+	printf("\n=======>>>: Total %d loops completed to get the results.  \n", loops);
+	printf("Number breakpoints picked out is: %ld\n", pickedCurveBP.size());
+	if(engine == ReduceEngine::Optimal)
+		printf("=======>>>: To reduce the breakpoints from %ld to %ld, the summed squared error is %g (%s) <<<=========\n\n",
+		       origCurveBP.size(), numOfBreakpoints, deviation, approximate ? OPTIMALAPPROXNAME ", --exact for the optimum" : "optimal");
+	else
+		printf("=======>>>: To reduce the breakpoints from %ld to %ld, the maximum deviation is %f <<<=========\n\n", origCurveBP.size(), numOfBreakpoints, deviation);
+	print_reduction_error();
+	printf("#################################################################################################\n\n");
+
+	return 0;
+}
+
+/* Error bound engine: pick breakpoints so that the linear interpolation between them is never off by more than maxError (in
+ * temperature) at any original breakpoint. The StreamingReducer is run over origCurveBP with the default window, so the picks
+ * are greedy and approximate, not necessarily the fewest, and at most STREAMWINDOW breakpoints are visited again per pick. */
+template<typename V>
+int BasicProcessCurve<V>::reduce_error_bound(double maxError)
+{
+	if(maxError < 0 || origCurveBP.size() < 2)
+		return -1;
+
+	StageTimer timer(StageReduce);
+	pickedCurveBP.clear();
+	pickIndex.clear();
+	pickSeen.clear();
+	approximate = false;
+	countTarget = 0;
+	StreamingReducer reducer(maxError, STREAMWINDOW, [this](const BreakPoint &, size_t seq, size_t seen)
+	{
+		pickIndex.push_back(seq);
+		pickSeen.push_back(std::max(seen, pickSeen.empty() ? 0 : pickSeen.back()));
+	});
+	for(auto &bp : origCurveBP)
+		reducer.push(BreakPoint(bp.sensorUnit, bp.temp));
+	reducer.finish();
+	pick_from_index();
+	boundError = maxError;
+	METRIC_ADD(bpIn, origCurveBP.size());
+	METRIC_ADD(bpOut, pickedCurveBP.size());
+
+	return 0;
+}
+
+/* Measure how far the reduced curve strays from the original one: pickedCurveBP is linearly interpolated at the sensor unit of
+ * every original breakpoint and compared with its temperature. Both curves are in sensor unit order, so they are walked together
+ * once, each section of the reduced curve covers a contiguous run of original breakpoints that is handed to the vectorised error
+ * kernel. Breakpoints outside the reduced curve are extrapolated from its first or last section. */
+template<typename V>
+int BasicProcessCurve<V>::verify_reduction(ReductionError &err) const
+{
+	size_t n = origCurveBP.size(), k = pickedCurveBP.size();
+	double sumSq = 0;
+	size_t worstBegin = 0, worstCount = 0;
+	double worstX0 = 0, worstY0 = 0, worstSlope = 0;
+
+	err = ReductionError{};
+	if(n == 0 || k < 2)
+		return -1;
+
+	size_t i = 0;
+	for(size_t s = 0; s + 1 < k; s++)
+	{
+		const Point &a = pickedCurveBP[s], &b = pickedCurveBP[s + 1];
+		double dx = double(b.sensorUnit) - a.sensorUnit;
+		if(dx <= 0 && s + 2 < k)
+			continue;                               // zero width section, its breakpoints go to the next one
+
+		// original breakpoints up to the end of this section, or all the rest for the last section
+		size_t end = i;
+		if(s + 2 == k)
+			end = n;
+		else
+			while(end < n && origCurveBP[end].sensorUnit <= b.sensorUnit)
+				end++;
+
+		double slope = dx > 0 ? (double(b.temp) - a.temp) / dx : 0;
+		double segMax = 0;
+		slopeKernels<V>.error(&origCurveBP[i], end - i, a.sensorUnit, a.temp, slope, segMax, sumSq);
+		if(end > i && (segMax > err.maxError || worstCount == 0))
+		{
+			err.maxError = segMax;
+			worstBegin = i;
+			worstCount = end - i;
+			worstX0 = a.sensorUnit;
+			worstY0 = a.temp;
+			worstSlope = slope;
+		}
+		i = end;
+	}
+
+	// find where the largest error is, only in the section that has it
+	err.worstIndex = worstBegin;
+	double worst = -1;
+	for(size_t j = worstBegin; j < worstBegin + worstCount; j++)
+	{
+		double e = fabs(origCurveBP[j].temp - (worstY0 + worstSlope * (origCurveBP[j].sensorUnit - worstX0)));
+		if(e > worst)
+		{
+			worst = e;
+			err.worstIndex = j;
+		}
+	}
+	err.worstSensorUnit = origCurveBP[err.worstIndex].sensorUnit;
+	err.rmsError = std::sqrt(sumSq / n);
+	err.numPoints = n;
+
+	return 0;
+}
+
+/* Print the verification result as one line of the summary. */
+template<typename V>
+void BasicProcessCurve<V>::print_reduction_error() const
+{
+	ReductionError err;
+	if(verify_reduction(err) == 0)
+		printf("=======>>>: Interpolation error: max %g at sensor unit %g (breakpoint %ld), RMS %g <<<=========\n", err.maxError,
+		       err.worstSensorUnit, err.worstIndex + 1, err.rmsError);
+}
+
+/* Ask for the allowed error and pick breakpoints greedily so that the curve stays within it. */
+template<typename V>
+int BasicProcessCurve<V>::process_curve_error_bound()
+{
+	std::string input;
+	double maxError;
+
+	if(origCurveBP.size() < 3)
+	{
+		std::cout << "Too few break points!" << std::endl;
+		return -1;
+	} 
+
+	std::cout << "What is the maximum allowed temperature error?" << std::endl;
+	std::getline(std::cin >> std::ws, input);
+	maxError = atof(input.c_str());
+	if(reduce_error_bound(maxError) < 0)
+	{
+		std::cout << "Invalid error bound: " << input << std::endl;
+		return -1;
+	}
+
+	printf("\n\n\n################################################################################################\n");
+	printf("Number breakpoints picked out is: %ld\n", pickedCurveBP.size());
+	printf("=======>>>: To keep the error within %f, the breakpoints are reduced from %ld to %ld <<<=========\n\n", maxError, origCurveBP.size(), pickedCurveBP.size());
+	print_reduction_error();
+	printf("#################################################################################################\n\n");
+
+	return 0;
+}
+
+/* Load a binary curve from its mapped data: check the header, copy the header fields and interleave the two arrays into
+ * origCurveBP. */
+template<typename V>
+int BasicProcessCurve<V>::load_binary_curve(std::string_view data)
+{
+	CurveBinHeader hdr;
+	memcpy(&hdr, data.data(), sizeof(hdr));
+
+	uint64_t arrayBytes = hdr.numBP * sizeof(double);
+	if(hdr.version != CURVEBINVERSION || hdr.headerOffset > data.size()
+	   || hdr.sensorUnitOffset % alignof(double) || hdr.tempOffset % alignof(double)
+	   || hdr.numBP > data.size() / sizeof(double)
+	   || hdr.sensorUnitOffset > data.size() - arrayBytes || hdr.tempOffset > data.size() - arrayBytes)
+	{
+		std::cerr << "Wrong binary curve format: " << fileName << std::endl;
+		return -1;
+	}
+
+	size_t pos = hdr.headerOffset;
+	for(uint32_t i = 0; i < hdr.numHeaders; i++)
+	{
+		uint32_t len;
+		if(pos + sizeof(len) > data.size())
+			return -1;
+		memcpy(&len, data.data() + pos, sizeof(len));
+		pos += sizeof(len);
+		if(len > data.size() - pos)
+			return -1;
+		curveHDR.emplace_back(data.substr(pos, len));
+		pos += len;
+	}
+
+	// the mapping is page aligned and the offsets are aligned, the arrays can be read in place
+	const double *sensorUnit = reinterpret_cast<const double *>(data.data() + hdr.sensorUnitOffset);
+	const double *temp = reinterpret_cast<const double *>(data.data() + hdr.tempOffset);
+	size_t base = origCurveBP.size();
+	origCurveBP.resize(base + hdr.numBP, Point{0, 0});
+	for(size_t i = 0; i < hdr.numBP; i++)
+	{
+		if(!value_fits<V>(sensorUnit[i]) || !value_fits<V>(temp[i]))
+		{
+			std::cerr << "Breakpoint " << i + 1 << " out of the " << valueTypeName<V> << " range: " << sensorUnit[i] << " " << temp[i]
+				  << ", " << fileName << std::endl;
+			origCurveBP.erase(origCurveBP.begin() + base, origCurveBP.end());
+			return -1;
+		}
+		origCurveBP[base + i].sensorUnit = sensorUnit[i];
+		origCurveBP[base + i].temp = temp[i];
+	}
+
+	return 0;
+}
+
+/* Write the header fields and the breakpoints bp into a binary curve file. */
+template<typename V>
+int BasicProcessCurve<V>::save_binary_curve(const std::string &name, const std::vector<Point> &bp) const
+{
+	static const char zeros[CURVEBINALIGN] = {};
+	CurveBinHeader hdr{};
+	std::vector<double> column(bp.size());
+
+	memcpy(hdr.magic, CURVEBINMAGIC, sizeof(hdr.magic));
+	hdr.version = CURVEBINVERSION;
+	hdr.numHeaders = curveHDR.size();
+	hdr.numBP = bp.size();
+	hdr.headerOffset = sizeof(hdr);
+
+	uint64_t pos = hdr.headerOffset;
+	for(auto &h : curveHDR)
+		pos += sizeof(uint32_t) + header_field(h, bp.size()).size();
+	auto align{ [](uint64_t p) { return (p + CURVEBINALIGN - 1) / CURVEBINALIGN * CURVEBINALIGN; } };
+	hdr.sensorUnitOffset = align(pos);
+	hdr.tempOffset = align(hdr.sensorUnitOffset + bp.size() * sizeof(double));
+
+	std::ofstream outf{name.c_str(), std::ios::binary};
+	if(!outf)
+	{
+		std::cerr << "Unable to open file: " << name << std::endl;
+		return -1;
+	}
+
+	outf.write(reinterpret_cast<const char *>(&hdr), sizeof(hdr));
+	for(auto &h : curveHDR)
+	{
+		std::string field = header_field(h, bp.size());
+		uint32_t len = field.size();
+		outf.write(reinterpret_cast<const char *>(&len), sizeof(len));
+		outf.write(field.data(), len);
+	}
+	outf.write(zeros, hdr.sensorUnitOffset - pos);
+
+	for(size_t i = 0; i < bp.size(); i++)
+		column[i] = bp[i].sensorUnit;
+	outf.write(reinterpret_cast<const char *>(column.data()), column.size() * sizeof(double));
+	outf.write(zeros, hdr.tempOffset - hdr.sensorUnitOffset - column.size() * sizeof(double));
+	for(size_t i = 0; i < bp.size(); i++)
+		column[i] = bp[i].temp;
+	outf.write(reinterpret_cast<const char *>(column.data()), column.size() * sizeof(double));
+
+	if(!outf)
+	{
+		std::cerr << "Error write to file: " << name << std::endl;
+		return -1;
+	}
+	return 0;
+}
+
+/* The "Number of Breakpoints:" header field is updated to the number of breakpoints saved, other fields are saved as they are. */
+template<typename V>
+std::string BasicProcessCurve<V>::header_field(std::string_view hdr, size_t numBP)
+{
+	if(hdr.starts_with("Number of Breakpoints:"))
+		return "Number of Breakpoints: " + std::to_string(numBP);
+	return std::string(hdr);
+}
+
+/* Save the header and the picked out breakpoints into outFileName, the same layout as the curve file that was read, or as a
+ * binary curve file if the name ends with CURVEBINEXT. If no output file has been set, ask the user whether and where to save. */
+template<typename V>
+int BasicProcessCurve<V>::save_processed_BP()
+{
+	if(outFileName.empty())
+	{
+		std::string answer;
+		std::cout << "Do you want to save the picked breakpoints into a file(Y/N)? " << std::endl;
+		std::getline(std::cin >> std::ws, answer);
+		if(answer.empty() || (answer[0] != 'Y' && answer[0] != 'y'))
+		{
+			std::cout << "The processed curve has not been saved!" << std::endl;
+			return 0;
+		}
+		std::cout << "Type in a file name to save the processed curve: " << std::endl;
+		std::getline(std::cin >> std::ws, outFileName);
+	}
+
+	StageTimer timer(StageSave);
+	if(is_binary_curve_name(outFileName))
+	{
+		if(save_binary_curve(outFileName, pickedCurveBP) < 0)
+			return -1;
+		if(verbose)
+			std::cout << "Processed Curve has been saved in binary file: " << outFileName << std::endl;
+		return 0;
+	}
+
+	std::ofstream outf{outFileName.c_str()};
+	if(!outf)
+	{
+		std::cerr << "Unable to open file: " << outFileName << std::endl;
+		return -1;
+	}
+
+	outf << "# Curve with reduced number of breakpoints, processed from " << fileName << "\n\n";
+	for(auto &hdr : curveHDR)
+		outf << header_field(hdr, pickedCurveBP.size()) << '\n';
+	outf << '\n';
+
+	char line[128];
+	for(size_t i = 0; i < pickedCurveBP.size(); i++)
+	{
+		snprintf(line, sizeof(line), "%ld %.*g %.*g\n", i + 1, printDigits<V>, double(pickedCurveBP[i].sensorUnit),
+			 printDigits<V>, double(pickedCurveBP[i].temp));
+		outf << line;
+	}
+
+	if(!outf)
+	{
+		std::cerr << "Error write to file: " << outFileName << std::endl;
+		return -1;
+	}
+	if(verbose)
+		std::cout << "Processed Curve has been saved in file: " << outFileName << std::endl;
+
+	return 0;
+}
+
+/* Keep all the breakpoints, used to convert a curve file without reducing it. */
+template<typename V>
+void BasicProcessCurve<V>::pick_all_BP()
+{
+	pickIndex.resize(origCurveBP.size());
+	std::iota(pickIndex.begin(), pickIndex.end(), 0);
+	boundError = -1;
+	countTarget = SIZE_MAX;
+	approximate = false;
+	pickedCurveBP.assign(origCurveBP.begin(), origCurveBP.end());
+}
+
+/* Forget the curve, so that the object can be reused for the next file. The arena and all the work buffers keep their memory,
+ * the next curve of at most the same size is processed without any allocation. */
+template<typename V>
+void BasicProcessCurve<V>::clear()
+{
+	std::pmr::vector<std::pmr::string>(&arena).swap(curveHDR);    // the containers have to let go of the arena before it is reset
+	std::pmr::vector<Point>(&arena).swap(origCurveBP);
+	arena.reset();
+	pickedCurveBP.clear();
+	pickIndex.clear();
+	pickSeen.clear();
+	boundError = -1;
+	countTarget = 0;
+	approximate = false;
+	invalidate_tables();
+	fileName.clear();
+	outFileName.clear();
+}
+
+/* Edits of the original curve, for a recalibration that touches a few breakpoints or appends a tail, without a new parse. The
+ * picked breakpoints are then the same as a new reduction of the edited curve would give:
+ *  - picks of an error bound reduction are repaired locally: the reducer is run again from the last pick that depends only on
+ *    breakpoints before the edit (pickSeen), until it picks a breakpoint behind the edit that it picked before. From there on the
+ *    old picks stand, as the reducer only looks at the breakpoints after its last pick.
+ *  - a reduction to a count is not repaired but done again in full, to the same count with the same engine: the merge order of
+ *    the greedy engine, the deviation the deviation engine finds and the split points of the optimal engine all depend on the
+ *    whole curve, an edit can change the picks anywhere. It costs what the reduction costs, O(n log n) for the greedy engine.
+ *  - all breakpoints stay picked after pick_all_BP().
+ * The edit itself moves the breakpoints behind it in memory (memmove) and drops the slope table and the merge hierarchy.
+ * Return 0, 1 if the count of the reduction can not be reached on the edited curve any more (all breakpoints are picked then), or
+ * -1 if the index is out of range, a value does not fit V or the sensor units would not be in ascending order any more (nothing
+ * is changed). */
+template<typename V>
+int BasicProcessCurve<V>::insert_BP(double sensorUnit, double temp)
+{
+	if(std::isnan(sensorUnit) || !value_fits<V>(sensorUnit) || !value_fits<V>(temp))
+		return -1;
+
+	Point bp(sensorUnit, temp);
+	auto before{ [](const Point &a, const Point &b) { return a.sensorUnit < b.sensorUnit; } };
+	// behind the breakpoints of the same sensor unit, an appended tail is not searched for
+	size_t e = origCurveBP.empty() || !before(bp, origCurveBP.back()) ? origCurveBP.size()
+		   : std::upper_bound(origCurveBP.begin(), origCurveBP.end(), bp, before) - origCurveBP.begin();
+	origCurveBP.insert(origCurveBP.begin() + e, bp);
+	invalidate_tables();
+	return repair_picks(e, 1);
+}
+
+template<typename V>
+int BasicProcessCurve<V>::update_BP(size_t index, double sensorUnit, double temp)
+{
+	size_t n = origCurveBP.size();
+	Point bp(sensorUnit, temp);
+
+	if(index >= n || std::isnan(sensorUnit) || !value_fits<V>(sensorUnit) || !value_fits<V>(temp) || (index > 0 && origCurveBP[index - 1].sensorUnit > bp.sensorUnit)
+	   || (index + 1 < n && bp.sensorUnit > origCurveBP[index + 1].sensorUnit))
+		return -1;
+
+	origCurveBP[index] = bp;
+	invalidate_tables();
+	return repair_picks(index, 0);
+}
+
+template<typename V>
+int BasicProcessCurve<V>::delete_BP(size_t index)
+{
+	if(index >= origCurveBP.size())
+		return -1;
+
+	origCurveBP.erase(origCurveBP.begin() + index);
+	invalidate_tables();
+	return repair_picks(index, -1);
+}
+
+/* Bring pickIndex and pickedCurveBP up to date after an edit at breakpoint e, change is +1 for an insert, 0 for an update and
+ * -1 for a delete. Returns like insert_BP(). */
+template<typename V>
+int BasicProcessCurve<V>::repair_picks(size_t e, int change)
+{
+	size_t n = origCurveBP.size();
+
+	if(countTarget > 0)
+	{
+		int loops = 0;
+		double deviation = 0;
+		if(countTarget >= n)
+			pick_all_BP();
+		else if(reduce_to_count(countTarget, loops, deviation) < 0)
+		{
+			pick_all_BP();
+			return 1;
+		}
+		return 0;
+	}
+	if(boundError < 0)
+		return 0;                                   // nothing reduced yet
+	if(n < 2)
+	{
+		pickIndex.assign(n, 0);
+		pickSeen.assign(n, 0);
+		pick_from_index();
+		return 0;
+	}
+
+	// picks that depend only on breakpoints before the edit stand
+	size_t keep = std::lower_bound(pickSeen.begin(), pickSeen.end(), e) - pickSeen.begin();
+
+	// the picks behind the edit move with their breakpoints
+	if(change < 0)
+	{
+		auto del = std::lower_bound(pickIndex.begin(), pickIndex.end(), e);
+		if(del != pickIndex.end() && *del == e)
+		{
+			pickSeen.erase(pickSeen.begin() + (del - pickIndex.begin()));
+			pickIndex.erase(del);
+		}
+	}
+	if(change != 0)
+	{
+		for(auto it = std::lower_bound(pickIndex.begin(), pickIndex.end(), e); it != pickIndex.end(); ++it)
+			*it += change;
+		for(auto it = pickSeen.begin() + keep; it != pickSeen.end(); ++it)
+			*it += change;
+	}
+
+	// run the error bound reducer again from the last pick that stands
+	size_t from = keep ? keep - 1 : 0;
+	size_t start = keep ? pickIndex[from] : 0;
+	size_t resyncFrom = e + (change >= 0);              // the breakpoints from here on are the old ones
+	size_t resync = pickIndex.size();
+	bool resynced = false;
+	std::vector<size_t> &fresh = bestPickIndex, &freshSeen = bestPickSeen;
+	fresh.clear();
+	freshSeen.clear();
+
+	StreamingReducer reducer(boundError, STREAMWINDOW, [&](const BreakPoint &, size_t seq, size_t seen)
+	{
+		size_t j = start + seq;
+		if(resynced)
+			return;
+		fresh.push_back(j);
+		freshSeen.push_back(std::max(start + seen, freshSeen.empty() ? (keep ? pickSeen[from] : 0) : freshSeen.back()));
+		if(j >= resyncFrom)
+		{
+			auto old = std::lower_bound(pickIndex.begin() + keep, pickIndex.end(), j);
+			if(old != pickIndex.end() && *old == j)
+			{
+				resynced = true;                    // the old pick is picked again, with the window that picked it now
+				resync = old - pickIndex.begin() + 1;
+			}
+		}
+	});
+	for(size_t i = start; i < n && !resynced; i++)
+		reducer.push(BreakPoint(origCurveBP[i].sensorUnit, origCurveBP[i].temp));
+	if(!resynced)
+		reducer.finish();
+
+	// the anchor is picked again by the reducer, the fresh picks replace the old ones up to the resync point
+	pickIndex.erase(pickIndex.begin() + from, pickIndex.begin() + resync);
+	pickIndex.insert(pickIndex.begin() + from, fresh.begin(), fresh.end());
+	pickSeen.erase(pickSeen.begin() + from, pickSeen.begin() + resync);
+	pickSeen.insert(pickSeen.begin() + from, freshSeen.begin(), freshSeen.end());
+	for(size_t i = from + fresh.size(); i < pickSeen.size() && i && pickSeen[i] < pickSeen[i - 1]; i++)
+		pickSeen[i] = pickSeen[i - 1];
+	pick_from_index();
+	return 0;
+}
+
+
+/*
+ * Work stealing thread pool. Every worker has its own task deque: it takes tasks from the back of its own deque and, when that
+ * is empty, steals from the front of the other workers' deques. A task gets the index of the worker running it, so that per
+ * worker state (like a ProcessCurve object) can be kept without locking.
+ */
+class WorkStealingPool
+{
+    public:
+	using Task = std::function<void(unsigned)>;
+
+	explicit WorkStealingPool(unsigned numWorkers);
+	~WorkStealingPool();
+	unsigned size() const { return queues.size(); }
+	void submit(Task task);
+	void wait();                                    // wait until all the submitted tasks are done
+
+    private:
+	struct TaskQueue
+	{
+		std::mutex lock;
+		std::deque<Task> tasks;
+	};
+
+	std::vector<std::unique_ptr<TaskQueue>> queues;
+	std::vector<std::thread> workers;
+	std::mutex idleLock;
+	std::condition_variable wakeup;
+	std::condition_variable allDone;
+	size_t queued{0};                               // submitted but not yet taken, protected by idleLock
+	std::atomic<size_t> pending{0};                 // submitted but not yet finished
+	std::atomic<unsigned> nextQueue{0};             // round robin over the deques, submit() is called from several threads
+	bool stopping{false};
+
+	bool take_task(unsigned self, Task &task);
+	void run(unsigned self);
+};
+
+WorkStealingPool::WorkStealingPool(unsigned numWorkers)
+{
+	if(numWorkers == 0)
+		numWorkers = 1;
+	for(unsigned i = 0; i < numWorkers; i++)
+		queues.push_back(std::make_unique<TaskQueue>());
+	for(unsigned i = 0; i < numWorkers; i++)
+		workers.emplace_back(&WorkStealingPool::run, this, i);
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+	{
+		std::lock_guard<std::mutex> lk(idleLock);
+		stopping = true;
+	}
+	wakeup.notify_all();
+	for(auto &w : workers)
+		w.join();
+}
+
+void WorkStealingPool::submit(Task task)
+{
+	pending++;
+	{
+		TaskQueue &q = *queues[nextQueue.fetch_add(1, std::memory_order_relaxed) % queues.size()];
+		std::lock_guard<std::mutex> lk(q.lock);
+		q.tasks.push_back(std::move(task));
+	}
+	{
+		std::lock_guard<std::mutex> lk(idleLock);
+		queued++;
+	}
+	wakeup.notify_one();
+}
+
+void WorkStealingPool::wait()
+{
+	std::unique_lock<std::mutex> lk(idleLock);
+	allDone.wait(lk, [this]{ return pending == 0; });
+}
+
+bool WorkStealingPool::take_task(unsigned self, Task &task)
+{
+	for(unsigned i = 0; i < queues.size(); i++)
+	{
+		unsigned victim = (self + i) % queues.size();
+		TaskQueue &q = *queues[victim];
+		std::lock_guard<std::mutex> lk(q.lock);
+		if(q.tasks.empty())
+			continue;
+		if(victim == self)
+		{                                           // own deque, newest first
+			task = std::move(q.tasks.back());
+			q.tasks.pop_back();
+		}
+		else
+		{                                           // steal the oldest
+			task = std::move(q.tasks.front());
+			q.tasks.pop_front();
+		}
+		return true;
+	}
+	return false;
+}
+
+void WorkStealingPool::run(unsigned self)
+{
+	while(1)
+	{
+		{
+			std::unique_lock<std::mutex> lk(idleLock);
+			wakeup.wait(lk, [this]{ return stopping || queued > 0; });
+			if(queued == 0)
+				return;                             // stopping and nothing left
+			queued--;
+		}
+
+		// a task was counted in queued, so one of the deques holds it
+		Task task;
+		while(!take_task(self, task))
+			std::this_thread::yield();
+		task(self);
+
+		if(--pending == 0)
+		{
+			std::lock_guard<std::mutex> lk(idleLock);
+			allDone.notify_all();
+		}
+	}
+}
+
+// Options of the non-interactive batch mode
+struct BatchOptions
+{
+	std::string input;                              // directory or glob pattern of curve files
+	std::string outDir{"reduced"};
+	size_t numOfBreakpoints{0};
+	double maxError{-1};                            // >= 0 selects the error bound mode
+	bool binary{false};                             // save the results as binary curve files
+	unsigned jobs{0};                               // 0 = one worker per core
+	ReduceEngine engine{ReduceEngine::Deviation};
+	SearchMode searchMode{SearchMode::Bisect};
+	bool exactOptimal{false};                       // the optimal engine solves every curve exactly, however long it takes
+	Precision precision{Precision::Double};         // value type the curves are processed in
+};
+
+/* All the regular files in a directory, or the files matching a glob pattern, sorted by name. */
+static std::vector<std::string> collect_curve_files(const std::string &input)
+{
+	std::vector<std::string> files;
+
+	if(std::filesystem::is_directory(input))
+	{
+		for(auto &entry : std::filesystem::directory_iterator(input))
+			if(entry.is_regular_file())
+				files.push_back(entry.path().string());
+	}
+	else
+	{
+		glob_t g;
+		if(glob(input.c_str(), 0, nullptr, &g) == 0)
+		{
+			for(size_t i = 0; i < g.gl_pathc; i++)
+				if(std::filesystem::is_regular_file(g.gl_pathv[i]))
+					files.push_back(g.gl_pathv[i]);
+		}
+		globfree(&g);
+	}
+	std::sort(files.begin(), files.end());
+	return files;
+}
+
+/* Reduce all the curve files of opt.input into opt.outDir, spread over a work stealing pool. Each worker has its own ProcessCurve,
+ * nothing is asked, one line per file is printed. Returns the number of files that failed. */
+template<typename V>
+static int run_batch(const BatchOptions &opt)
+{
+	std::vector<std::string> files = collect_curve_files(opt.input);
+	if(files.empty())
+	{
+		std::cerr << "No curve file found in: " << opt.input << std::endl;
+		return -1;
+	}
+
+	std::error_code ec;
+	std::filesystem::create_directories(opt.outDir, ec);
+	if(ec)
+	{
+		std::cerr << "Unable to create directory: " << opt.outDir << std::endl;
+		return -1;
+	}
+
+	unsigned jobs = opt.jobs ? opt.jobs : std::max(1u, std::thread::hardware_concurrency());
+	jobs = std::min<size_t>(jobs, files.size());
+	std::vector<BasicProcessCurve<V>> curves(jobs);
+	for(auto &pc : curves)
+	{
+		pc.set_verbose(false);
+		pc.set_engine(opt.engine);
+		pc.set_search_mode(opt.searchMode);
+		pc.set_exact_optimal(opt.exactOptimal);
+		pc.set_threads(1);                          // the files are already spread over the cores
+	}
+
+	std::mutex printLock;
+	std::atomic<int> failed{0};
+	WorkStealingPool pool(jobs);
+
+	for(auto &file : files)
+	{
+		pool.submit([&, file](unsigned worker)
+		{
+			BasicProcessCurve<V> &pc = curves[worker];
+			std::filesystem::path out = std::filesystem::path(opt.outDir) / std::filesystem::path(file).filename();
+			if(opt.binary)
+				out.replace_extension(CURVEBINEXT);
+			int loops = 0, ret;
+			double deviation = 0;
+			std::string why;
+
+			pc.clear();
+			pc.set_fileName(file);
+			pc.set_output_file(out.string());
+			if((ret = pc.parse_curve_file()) < 0)
+				why = "parse error";
+			else if((ret = pc.validate_data()) < 0)
+				why = "sensor units not in ascending order";
+			else if(opt.maxError >= 0 && (ret = pc.reduce_error_bound(opt.maxError)) < 0)
+				why = "invalid error bound";
+			else if(opt.maxError < 0 && (ret = pc.reduce_to_count(opt.numOfBreakpoints, loops, deviation)) < 0)
+			{
+				if(ret == -2)
+					why = "number of breakpoints should not less than " + std::to_string(pc.min_breakpoints());
+				else
+					why = "unable to reduce, " + std::to_string(pc.num_picked_BP()) + " picked out after " + std::to_string(loops) + " loops";
+			}
+			else if((ret = pc.save_processed_BP()) < 0)
+				why = "unable to save " + out.string();
+
+			std::lock_guard<std::mutex> lk(printLock);
+			if(ret < 0)
+			{
+				failed++;
+				std::cerr << file << ": failed, " << why << std::endl;
+			}
+			else
+			{
+				ReductionError err;
+				pc.verify_reduction(err);
+				std::cout << file << ": " << pc.num_orig_BP() << " -> " << pc.num_picked_BP() << " breakpoints, max error " << err.maxError
+					  << " at " << err.worstSensorUnit << ", RMS " << err.rmsError << (pc.is_approximate() ? " (" OPTIMALAPPROXNAME ")" : "")
+					  << ", " << out.string() << std::endl;
+			}
+		});
+	}
+	pool.wait();
+
+	std::cout << files.size() - failed << " of " << files.size() << " curve files processed with " << jobs << " workers." << std::endl;
+	return failed;
+}
+
+/* Convert a curve file between the text and the binary format, the format of the output is chosen by its name. */
+static int convert_curve(const std::string &in, const std::string &out)
+{
+	ProcessCurve pc;
+	pc.set_verbose(false);
+	pc.set_fileName(in);
+	pc.set_output_file(out);
+	if(pc.parse_curve_file() < 0)
+		return -1;
+	pc.pick_all_BP();
+	if(pc.save_processed_BP() < 0)
+		return -1;
+	std::cout << in << ": " << pc.num_orig_BP() << " breakpoints converted to " << out << std::endl;
+	return 0;
+}
+
+/* Record the greedy merge sequence of a curve and export its K versus error Pareto curve. */
+static int export_curve_pareto(const std::string &in, const std::string &out)
+{
+	ProcessCurve pc;
+	pc.set_verbose(false);
+	pc.set_fileName(in);
+	if(pc.parse_curve_file() < 0 || pc.validate_data() < 0 || pc.export_pareto(out) < 0)
+		return -1;
+	std::cout << in << ": Pareto curve of " << pc.num_orig_BP() << " breakpoints saved in " << out << std::endl;
+	return 0;
+}
+
+static const char *engine_name(ReduceEngine e)
+{
+	switch(e)
+	{
+	case ReduceEngine::Greedy:
+		return "greedy";
+	case ReduceEngine::Optimal:
+		return "optimal";
+	case ReduceEngine::Legacy:
+		return "legacy";
+	default:
+		return "deviation";
+	}
+}
+
+/* The engine of a name, false for an unknown name. */
+static bool engine_from_name(std::string_view name, ReduceEngine &e)
+{
+	for(ReduceEngine r : {ReduceEngine::Deviation, ReduceEngine::Greedy, ReduceEngine::Optimal, ReduceEngine::Legacy})
+		if(name == engine_name(r))
+		{
+			e = r;
+			return true;
+		}
+	return false;
+}
+
+// Shapes of the synthetic curves
+static const char *const curveShapes[] = {"monotone", "noisy", "oscillating", "plateau"};
+
+/* Write a synthetic curve file of numBP breakpoints over sensor units 1..100:
+ *   monotone:    a thermistor like 300 / x
+ *   noisy:       the monotone curve with uniform noise
+ *   oscillating: a sine wave riding on a slope, many sign changes of the slope
+ *   plateau:     flat steps joined by ramps going up and down
+ * The same shape and size always gives the same file. */
+static int generate_curve(std::string_view shape, size_t numBP, const std::string &name)
+{
+	std::mt19937_64 rng(numBP);
+	std::uniform_real_distribution<double> noise(-0.05, 0.05);
+	std::ofstream outf{name.c_str()};
+	char line[96];
+
+	if(!outf || numBP < 2 || std::find(std::begin(curveShapes), std::end(curveShapes), shape) == std::end(curveShapes))
+		return -1;
+
+	outf << "Sensor Model: SYNTHETIC-" << shape << "\nSerial Number: " << numBP << "\nData Format: 3\n"
+	     << "Number of Breakpoints: " << numBP << "\nTemperature Unit: K\n\n";
+	for(size_t i = 0; i < numBP; i++)
+	{
+		double x = 1 + 99.0 * i / (numBP - 1);
+		double t;
+		if(shape == "monotone")
+			t = 300 / x;
+		else if(shape == "noisy")
+			t = 300 / x + noise(rng);
+		else if(shape == "oscillating")
+			t = 0.5 * x + 10 * sin(x * 2);
+		else
+		{
+			double step = floor(x / 10), frac = x / 10 - step;
+			double level = (int)step % 2 ? 50 - step : 50 + step;
+			t = frac < 0.7 ? level : level + (frac - 0.7) / 0.3 * ((int)step % 2 ? 2 * step + 1 : -2 * step - 1);
+		}
+		snprintf(line, sizeof(line), "%ld %.10g %.10g\n", i + 1, x, t);
+		outf << line;
+	}
+
+	return outf ? 0 : -1;
+}
+
+// Options of the benchmark mode
+struct BenchOptions
+{
+	std::vector<size_t> sizes{1000, 10000, 100000, 1000000};
+	std::vector<std::string> shapes{std::begin(curveShapes), std::end(curveShapes)};
+	int reps{5};
+	std::vector<std::string> strategies;            // of --compare, empty: all of them
+};
+
+static long peak_rss_kb()
+{
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_maxrss;
+}
+
+/* Time parse_curve_file, validate_data and the reduction separately on synthetic curves of every shape and size, opt.reps runs
+ * each. One JSON object per line is printed: best and mean ns per breakpoint of every stage, the passes the reduction took, the
+ * number of breakpoints picked out, the readings per second one core converts through the CurveLookup of the reduced curve in
+ * both modes and the peak RSS of the process so far. Without a target count or error bound the curves are
+ * reduced to the smallest count the engine allows. */
+template<typename V>
+static int run_bench(const BatchOptions &opt, const BenchOptions &bench)
+{
+	using clock = std::chrono::steady_clock;
+	auto ns{ [](clock::duration d) { return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(d).count(); } };
+
+	for(auto &shape : bench.shapes)
+	{
+		for(size_t n : bench.sizes)
+		{
+			std::filesystem::path file = std::filesystem::temp_directory_path()
+						     / ("curve_bench_" + std::to_string(getpid()) + "_" + shape + "_" + std::to_string(n) + ".curve");
+			if(generate_curve(shape, n, file.string()) < 0)
+			{
+				std::cerr << "Unable to generate curve: " << shape << " " << n << std::endl;
+				return -1;
+			}
+
+			double best[3] = {1e300, 1e300, 1e300}, sum[3] = {0, 0, 0};
+			int loops = 0, ret = 0;
+			size_t picked = 0;
+			bool approximate = false;
+			std::vector<BasicBreakPoint<V>> pickedBP;
+			BasicProcessCurve<V> pc;                    // reused like a batch worker does, the later reps allocate nothing
+			for(int r = 0; r < bench.reps && ret >= 0; r++)
+			{
+				double deviation = 0, t[3];
+				pc.clear();
+				pc.set_verbose(false);
+				pc.set_engine(opt.engine);
+				pc.set_search_mode(opt.searchMode);
+				pc.set_exact_optimal(opt.exactOptimal);
+				pc.set_fileName(file.string());
+
+				auto t0 = clock::now();
+				ret = pc.parse_curve_file();
+				auto t1 = clock::now();
+				if(ret == 0)
+					ret = pc.validate_data();
+				auto t2 = clock::now();
+				if(ret == 0 && opt.maxError >= 0)
+				{
+					loops = 1;
+					ret = pc.reduce_error_bound(opt.maxError);
+				}
+				else if(ret == 0)
+					ret = pc.reduce_to_count(opt.numOfBreakpoints ? opt.numOfBreakpoints : pc.min_breakpoints(), loops, deviation);
+				auto t3 = clock::now();
+
+				t[0] = ns(t1 - t0);
+				t[1] = ns(t2 - t1);
+				t[2] = ns(t3 - t2);
+				for(int s = 0; s < 3; s++)
+				{
+					best[s] = std::min(best[s], t[s]);
+					sum[s] += t[s];
+				}
+				picked = pc.num_picked_BP();
+				approximate = pc.is_approximate();
+				if(r == 0)
+					pickedBP = pc.picked_BP();
+			}
+			std::filesystem::remove(file);
+
+			// readings per second of one core through the temperature lookup over the reduced curve
+			double perSec[2] = {0, 0};
+			if(pickedBP.size() >= 2)
+			{
+				std::vector<double> in(LOOKUPBENCHREADINGS), out(LOOKUPBENCHREADINGS);
+				std::mt19937_64 rng(n);
+				std::uniform_real_distribution<double> reading(pickedBP.front().sensorUnit, pickedBP.back().sensorUnit);
+				for(auto &v : in)
+					v = reading(rng);
+				for(int m = 0; m < 2; m++)
+				{
+					CurveLookup lk(pickedBP, m == 0 ? CurveLookup::Mode::Eytzinger : CurveLookup::Mode::Grid);
+					double bestNs = 1e300;
+					for(int r = 0; r < bench.reps; r++)
+					{
+						auto t0 = clock::now();
+						lk.lookup(in, out);
+						bestNs = std::min(bestNs, ns(clock::now() - t0));
+					}
+					perSec[m] = in.size() / bestNs * 1e9;
+				}
+			}
+
+			printf("{\"shape\":\"%s\",\"points\":%ld,\"engine\":\"%s\",\"precision\":\"%s\",\"simd\":\"%s\",\"reps\":%d,\"status\":%d,"
+			       "\"parse_ns_per_point\":%.3f,\"parse_ns_per_point_mean\":%.3f,"
+			       "\"validate_ns_per_point\":%.3f,\"validate_ns_per_point_mean\":%.3f,"
+			       "\"reduce_ns_per_point\":%.3f,\"reduce_ns_per_point_mean\":%.3f,"
+			       "\"passes\":%d,\"picked\":%ld,\"approximate\":%s,\"lookup_eytzinger_per_sec\":%.0f,\"lookup_grid_per_sec\":%.0f,\"peak_rss_kb\":%ld}\n",
+			       shape.c_str(), n, opt.maxError >= 0 ? "errorbound" : approximate ? OPTIMALAPPROXNAME : engine_name(opt.engine),
+			       precision_name(opt.precision),
+			       slopeKernels<V>.name, bench.reps, ret,
+			       best[0] / n, sum[0] / bench.reps / n, best[1] / n, sum[1] / bench.reps / n, best[2] / n, sum[2] / bench.reps / n,
+			       loops, picked, approximate ? "true" : "false", perSec[0], perSec[1], peak_rss_kb());
+			fflush(stdout);
+		}
+	}
+	return 0;
+}
+
+// A reduction strategy of the --compare harness: an engine, with its search mode for the deviation engine
+struct CompareStrategy
+{
+	const char *name;
+	ReduceEngine engine;
+	SearchMode searchMode;
+	bool errorBound;                                // the error bound engine, its bound is bisected to reach the count
+	bool onlyNamed;                                 // run only if named by --strategies
+};
+
+static const CompareStrategy compareStrategies[] = {
+	{"legacy", ReduceEngine::Legacy, SearchMode::Linear, false, true},     // its steps of 0.0005 take minutes on long noisy curves
+	{"deviation-linear", ReduceEngine::Deviation, SearchMode::Linear, false, false},
+	{"deviation-bisect", ReduceEngine::Deviation, SearchMode::Bisect, false, false},
+	{"greedy", ReduceEngine::Greedy, SearchMode::Bisect, false, false},
+	{"optimal", ReduceEngine::Optimal, SearchMode::Bisect, false, false},
+	{"errorbound", ReduceEngine::Deviation, SearchMode::Bisect, true, false}};
+
+/* Reduce to at most numOfBreakpoints with the error bound engine: the bound is doubled until the count fits, then bisected down
+ * to the smallest bound that still fits. Returns like reduce_to_count(), bound is the error bound used. */
+template<typename V>
+static int reduce_error_bound_to_count(BasicProcessCurve<V> &pc, size_t numOfBreakpoints, int &loops, double &bound)
+{
+	double lo = 0, hi = 1e-6;
+
+	loops = 0;
+	bound = 0;
+	if(pc.num_orig_BP() < 3 || numOfBreakpoints < 2)
+		return -2;
+	if(numOfBreakpoints > pc.num_orig_BP())
+	{
+		pc.pick_all_BP();
+		return 1;
+	}
+
+	while(1)
+	{
+		loops++;
+		if(pc.reduce_error_bound(hi) < 0)
+			return -1;
+		if(pc.num_picked_BP() <= numOfBreakpoints)
+			break;
+		if(hi > 1e300)
+			return -1;
+		lo = hi;
+		hi *= 2;
+	}
+	while(hi - lo > DEVIATIONEPS * std::max(1.0, hi))
+	{
+		double mid = lo + (hi - lo) / 2;
+		loops++;
+		pc.reduce_error_bound(mid);
+		if(pc.num_picked_BP() <= numOfBreakpoints)
+			hi = mid;
+		else
+			lo = mid;
+	}
+
+	loops++;
+	pc.reduce_error_bound(hi);
+	bound = hi;
+	return 0;
+}
+
+/* Differential benchmark: run every strategy on the same corpus of curve files, all reduced to the same count, and print one CSV
+ * row per file and strategy: the time of the reduction (best of the reps, parsing is not timed), the heap the first reduction on
+ * a fresh curve allocates (built with COUNTALLOCATIONS, "make process_curve_counted", left blank otherwise), the peak resident
+ * memory of the process so far, the count achieved and the interpolation error of the result (left blank if the strategy failed).
+ * Without --count every curve is reduced to the smallest count the deviation engine allows, n / 2 + 2, so that all the strategies
+ * can reach it. The legacy strategy is run only if named by --strategies. */
+template<typename V>
+static int run_compare(const BatchOptions &opt, const BenchOptions &bench)
+{
+	using clock = std::chrono::steady_clock;
+	std::vector<const CompareStrategy *> strategies;
+
+	for(auto &st : compareStrategies)
+		if(bench.strategies.empty() ? !st.onlyNamed : std::find(bench.strategies.begin(), bench.strategies.end(), st.name) != bench.strategies.end())
+			strategies.push_back(&st);
+	if(strategies.size() < std::max<size_t>(bench.strategies.size(), 1))
+	{
+		std::cerr << "Unknown strategy, one of: legacy, deviation-linear, deviation-bisect, greedy, optimal, errorbound" << std::endl;
+		return -1;
+	}
+
+	std::vector<std::string> files = collect_curve_files(opt.input);
+	if(files.empty())
+	{
+		std::cerr << "No curve file found in: " << opt.input << std::endl;
+		return -1;
+	}
+
+	printf("file,points,strategy,precision,target,picked,status,approximate,loops,max_error,rms_error,reduce_ms_best,reduce_ms_mean,"
+	       "allocations,bytes_allocated,peak_rss_kb\n");
+	for(auto &file : files)
+	{
+		for(auto st : strategies)
+		{
+			BasicProcessCurve<V> pc;
+			size_t target = 0;
+			double best = 1e300, sum = 0, deviation = 0;
+			uint64_t allocations = 0, bytes = 0;
+			int loops = 0, ret = 0;
+			bool wasEnabled = metricsEnabled, parsed = true;
+
+			for(int r = 0; r < bench.reps; r++)
+			{
+				// every rep reduces the curve as parsed, like run_bench; only the reduction is timed
+				pc.clear();
+				pc.set_verbose(false);
+				pc.set_engine(st->engine);
+				pc.set_search_mode(st->searchMode);
+				pc.set_exact_optimal(opt.exactOptimal);
+				pc.set_fileName(file);
+				if(pc.parse_curve_file() < 0 || pc.validate_data() < 0)
+				{
+					parsed = false;
+					break;
+				}
+				target = opt.numOfBreakpoints ? opt.numOfBreakpoints : pc.num_orig_BP() / 2 + 2;
+
+				if(r == 0)
+				{   // count the heap of the first reduction, only operator new sees the work buffers of the engines
+					metricsEnabled = true;
+					allocations = metrics.allocations.load();
+					bytes = metrics.bytesAllocated.load();
+				}
+				auto t0 = clock::now();
+				ret = st->errorBound ? reduce_error_bound_to_count(pc, target, loops, deviation) : pc.reduce_to_count(target, loops, deviation);
+				double ms = std::chrono::duration<double, std::milli>(clock::now() - t0).count();
+				if(r == 0)
+				{
+					allocations = metrics.allocations.load() - allocations;
+					bytes = metrics.bytesAllocated.load() - bytes;
+					metricsEnabled = wasEnabled;
+				}
+				best = std::min(best, ms);
+				sum += ms;
+			}
+			if(!parsed)
+			{
+				std::cerr << file << ": failed, unable to parse" << std::endl;
+				break;
+			}
+
+			printf("%s,%ld,%s,%s,%ld,%ld,%d,%d,%d,", file.c_str(), pc.num_orig_BP(), pc.is_approximate() ? OPTIMALAPPROXNAME : st->name,
+			       precision_name(opt.precision), target,
+			       pc.num_picked_BP(), ret, pc.is_approximate(), loops);
+			ReductionError err;
+			if(ret >= 0 && pc.verify_reduction(err) == 0)
+				printf("%.9g,%.9g,", err.maxError, err.rmsError);
+			else
+				printf(",,");                           // a failed strategy has no error, 0 would look like the best one
+			printf("%.6f,%.6f,", best, sum / bench.reps);
+#ifdef COUNTALLOCATIONS
+			printf("%lu,%lu,", allocations, bytes);
+#else
+			printf(",,");                           // not counted without COUNTALLOCATIONS
+#endif
+			printf("%ld\n", peak_rss_kb());
+			fflush(stdout);
+		}
+	}
+	return 0;
+}
+
+/* Split a comma separated list. */
+static std::vector<std::string> split_list(std::string_view list)
+{
+	std::vector<std::string> items;
+	while(!list.empty())
+	{
+		size_t comma = list.find(',');
+		if(comma != 0)
+			items.emplace_back(list.substr(0, comma));
+		list.remove_prefix(comma == std::string_view::npos ? list.size() : comma + 1);
+	}
+	return items;
+}
+
+/* Reduce a curve read from stdin, a pipe for example, with the error bound reducer and write every picked breakpoint to stdout as
+ * soon as it is decided. Header fields are passed through, comments are dropped. Memory stays bounded by the window. */
+static int run_stream(double maxError, size_t window)
+{
+	std::string line;
+	bool bppstarted = false;
+	double r = 0, t = 0, lastR = -std::numeric_limits<double>::infinity();
+	size_t seq = 0;
+
+	StreamingReducer reducer(maxError, window, [&seq](const BreakPoint &bp, size_t, size_t)
+	{
+		printf("%ld %.10g %.10g\n", ++seq, bp.sensorUnit, bp.temp);
+		fflush(stdout);
+	});
+
+	while(std::getline(std::cin, line))
+	{
+		switch(parse_curve_line(line, bppstarted, r, t))
+		{
+		case CurveLine::Header:
+			printf("%s\n", line.c_str());
+			break;
+		case CurveLine::BreakPoint:
+			if(r < lastR)
+			{
+				std::cerr << "File error: sensor unit " << r << " after " << lastR << std::endl;
+				return -1;
+			}
+			if(seq == 0)
+				printf("\n");                       // blank line between the header and the breakpoints
+			lastR = r;
+			reducer.push(BreakPoint{r, t});
+			break;
+		case CurveLine::Error:
+			std::cerr << "Wrong curve format!" << std::endl;
+			return -1;
+		case CurveLine::Skip:
+			break;
+		}
+	}
+	reducer.finish();
+
+	return 0;
+}
+
+/*
+ * Reduction service on a Unix domain socket. Curves are parsed once and kept in memory, so that reducing or looking up a cached
+ * curve costs only the work itself. Every client connection has a thread of its own that reads its requests, an idle client costs
+ * that thread only. The reductions are handed to a work stealing pool, so that no more of them than it has workers run at once.
+ * One request and one reply per line:
+ *
+ *   LOAD <name> <file>                                        parse a curve file and cache it under name
+ *   REDUCE <name> COUNT <K> [deviation|greedy|optimal|legacy] reduce the cached curve to K breakpoints
+ *   REDUCE <name> ERROR <X>                                   reduce with the error bound X
+ *   INSERT <name> <sensorUnit> <temp>                         add a breakpoint to the cached curve
+ *   UPDATE <name> <index> <sensorUnit> <temp>                 move breakpoint index, it stays between its neighbours
+ *   DELETE <name> <index>                                     remove breakpoint index
+ *   LOOKUP <name> <sensorUnit> ...                            temperatures of the readings on the (reduced) curve
+ *   SAVE <name> <file>                                        save the (reduced) curve
+ *   DROP <name> | LIST | METRICS | QUIT | SHUTDOWN
+ *
+ * Replies start with "OK" or "ERR". A REDUCE reply ends with "optimal-approx" when the optimal engine gave an approximation on
+ * a long curve. An edit keeps the last reduction of the curve up to date (an error bound reduction is repaired around the edit, a
+ * reduction to a count is done again in full), its reply ends with "all picked" when the count can no longer be reached. Requests on different curves run in parallel, lookups on the same curve too.
+ */
+class CurveServer
+{
+    public:
+	CurveServer(const std::string &socketPath, unsigned jobs) : socketPath{socketPath}, pool{jobs} {}
+	int run();
+
+    private:
+	struct CachedCurve
+	{
+		std::shared_mutex lock;                     // shared for lookups, exclusive for reductions
+		ProcessCurve pc;
+		CurveLookup lookup;
+	};
+
+	struct Client
+	{
+		int fd;                                     // closed by run() once the thread is joined
+		std::thread thread;
+		std::atomic<bool> done{false};
+	};
+
+	std::string socketPath;
+	WorkStealingPool pool;
+	std::shared_mutex cacheLock;
+	std::map<std::string, std::shared_ptr<CachedCurve>, std::less<>> cache;
+	std::list<Client> clients;                      // only run() touches it
+	std::atomic<bool> stopping{false};
+	int listenFd{-1};
+
+	void serve_client(Client &client);
+	void join_clients(bool all);
+	std::string handle(std::string_view request, bool &quit);
+	std::string on_pool(std::function<std::string()> work);
+	std::shared_ptr<CachedCurve> find(std::string_view name);
+};
+
+/* Parse a whole token as an unsigned integer, false if it is not one or out of range. */
+static bool parse_size(std::string_view token, size_t &v)
+{
+	auto [end, ec] = std::from_chars(token.data(), token.data() + token.size(), v);
+	return ec == std::errc() && end == token.data() + token.size();
+}
+
+/* Run work on a worker of the pool and wait for its reply. */
+std::string CurveServer::on_pool(std::function<std::string()> work)
+{
+	std::promise<std::string> reply;
+	std::future<std::string> done = reply.get_future();
+	pool.submit([&](unsigned)
+	{
+		try
+		{
+			reply.set_value(work());
+		}
+		catch(...)
+		{
+			reply.set_exception(std::current_exception());
+		}
+	});
+	return done.get();
+}
+
+std::shared_ptr<CurveServer::CachedCurve> CurveServer::find(std::string_view name)
+{
+	std::shared_lock<std::shared_mutex> lk(cacheLock);
+	auto it = cache.find(name);
+	return it == cache.end() ? nullptr : it->second;
+}
+
+std::string CurveServer::handle(std::string_view request, bool &quit)
+{
+	std::vector<std::string_view> args;
+	constexpr std::string_view delims{" \t\r"};
+	for(size_t start = request.find_first_not_of(delims); start != std::string_view::npos; )
+	{
+		size_t end = request.find_first_of(delims, start);
+		args.push_back(request.substr(start, end == std::string_view::npos ? std::string_view::npos : end - start));
+		start = end == std::string_view::npos ? end : request.find_first_not_of(delims, end);
+	}
+	if(args.empty())
+		return "ERR empty request";
+
+	std::string_view cmd = args[0];
+	char reply[160];
+
+	if(cmd == "QUIT")
+	{
+		quit = true;
+		return "OK bye";
+	}
+	if(cmd == "SHUTDOWN")
+	{
+		quit = true;
+		stopping = true;
+		::shutdown(listenFd, SHUT_RDWR);            // wake up accept()
+		return "OK shutting down";
+	}
+	if(cmd == "METRICS")
+		return metricsEnabled ? "OK " + metrics.json() : std::string("ERR metrics are not enabled, start with --metrics");
+	if(cmd == "LIST")
+	{
+		std::string r = "OK";
+		std::shared_lock<std::shared_mutex> lk(cacheLock);
+		for(auto &[name, c] : cache)
+			r += " " + name;
+		return r;
+	}
+	if(cmd != "LOAD" && cmd != "DROP" && cmd != "REDUCE" && cmd != "INSERT" && cmd != "UPDATE" && cmd != "DELETE" && cmd != "LOOKUP"
+	   && cmd != "SAVE")
+		return "ERR unknown request " + std::string(cmd);
+	if(args.size() < 2)
+		return "ERR missing curve name";
+	std::string name{args[1]};
+
+	if(cmd == "LOAD" && args.size() == 3)
+	{
+		auto c = std::make_shared<CachedCurve>();
+		c->pc.set_verbose(false);
+		c->pc.set_threads(1);
+		c->pc.set_fileName(std::string(args[2]));
+		if(c->pc.parse_curve_file() < 0 || c->pc.validate_data() < 0 || c->pc.num_orig_BP() < 2)
+			return "ERR unable to load " + std::string(args[2]);
+		c->pc.pick_all_BP();
+		c->lookup.build(c->pc.picked_BP());
+		std::unique_lock<std::shared_mutex> lk(cacheLock);
+		cache[name] = c;
+		snprintf(reply, sizeof(reply), "OK %ld breakpoints", c->pc.num_orig_BP());
+		return reply;
+	}
+	if(cmd == "DROP")
+	{
+		std::unique_lock<std::shared_mutex> lk(cacheLock);
+		return cache.erase(name) ? "OK" : "ERR no curve " + name;
+	}
+
+	std::shared_ptr<CachedCurve> c = find(name);
+	if(!c)
+		return "ERR no curve " + name;
+
+	if(cmd == "REDUCE" && args.size() >= 4)
+	{
+		size_t count = 0;
+		ReduceEngine e = ReduceEngine::Deviation;
+		if(args[2] == "COUNT" && !parse_size(args[3], count))
+			return "ERR invalid count " + std::string(args[3]);
+		if(args[2] == "COUNT" && args.size() > 4 && !engine_from_name(args[4], e))
+			return "ERR unknown engine " + std::string(args[4]);
+		if(args[2] != "COUNT" && args[2] != "ERROR")
+			return "ERR unknown reduction " + std::string(args[2]);
+
+		return on_pool([&]
+		{
+			std::unique_lock<std::shared_mutex> lk(c->lock);
+			int ret, loops = 0;
+			double deviation = 0;
+			if(args[2] == "ERROR")
+				ret = c->pc.reduce_error_bound(to_double(args[3]));
+			else
+			{
+				c->pc.set_engine(e);
+				ret = c->pc.reduce_to_count(count, loops, deviation);
+			}
+			if(ret < 0)
+			{
+				c->pc.pick_all_BP();
+				c->lookup.build(c->pc.picked_BP());
+				return ret == -2 ? "ERR number of breakpoints should not less than " + std::to_string(c->pc.min_breakpoints())
+						 : std::string("ERR unable to reduce");
+			}
+			c->lookup.build(c->pc.picked_BP());
+			ReductionError err;
+			c->pc.verify_reduction(err);
+			snprintf(reply, sizeof(reply), "OK %ld breakpoints max_error %g rms %g%s", c->pc.num_picked_BP(), err.maxError,
+				 err.rmsError, c->pc.is_approximate() ? " " OPTIMALAPPROXNAME : "");
+			return std::string(reply);
+		});
+	}
+	if((cmd == "INSERT" && args.size() == 4) || (cmd == "UPDATE" && args.size() == 5) || (cmd == "DELETE" && args.size() == 3))
+	{
+		size_t index = 0;
+		if(cmd != "INSERT" && !parse_size(args[2], index))
+			return "ERR invalid index " + std::string(args[2]);
+
+		return on_pool([&]
+		{
+			std::unique_lock<std::shared_mutex> lk(c->lock);
+			int ret;
+			if(cmd == "INSERT")
+				ret = c->pc.insert_BP(to_double(args[2]), to_double(args[3]));
+			else if(cmd == "UPDATE")
+				ret = c->pc.update_BP(index, to_double(args[3]), to_double(args[4]));
+			else
+				ret = c->pc.delete_BP(index);
+			if(ret < 0)
+				return "ERR unable to edit " + name;
+			c->lookup.build(c->pc.picked_BP());
+			snprintf(reply, sizeof(reply), "OK %ld breakpoints %ld picked%s", c->pc.num_orig_BP(), c->pc.num_picked_BP(),
+				 ret == 1 ? " all picked" : "");
+			return std::string(reply);
+		});
+	}
+	if(cmd == "LOOKUP" && args.size() >= 3)
+	{
+		std::shared_lock<std::shared_mutex> lk(c->lock);
+		std::string r = "OK";
+		for(size_t i = 2; i < args.size(); i++)
+		{
+			snprintf(reply, sizeof(reply), " %.10g", c->lookup.lookup(to_double(args[i])));
+			r += reply;
+		}
+		return r;
+	}
+	if(cmd == "SAVE" && args.size() == 3)
+	{
+		std::unique_lock<std::shared_mutex> lk(c->lock);
+		c->pc.set_output_file(std::string(args[2]));
+		return c->pc.save_processed_BP() < 0 ? "ERR unable to save " + std::string(args[2]) : "OK";
+	}
+
+	return "ERR bad request: " + std::string(request);
+}
+
+void CurveServer::serve_client(Client &client)
+{
+	int fd = client.fd;
+	std::string buffer;
+	char chunk[4096];
+	bool quit = false;
+
+	while(!quit)
+	{
+		ssize_t got = recv(fd, chunk, sizeof(chunk), 0);
+		if(got <= 0)
+			break;
+		buffer.append(chunk, got);
+
+		size_t start = 0, eol;
+		while(!quit && (eol = buffer.find('\n', start)) != std::string::npos)
+		{
+			std::string reply = handle(std::string_view(buffer).substr(start, eol - start), quit);
+			reply += '\n';
+			if(send(fd, reply.data(), reply.size(), MSG_NOSIGNAL) < 0)
+				quit = true;
+			start = eol + 1;
+		}
+		buffer.erase(0, start);
+	}
+	client.done = true;
+}
+
+/* Join the client threads that are done, or all of them once their reads have been shut down. */
+void CurveServer::join_clients(bool all)
+{
+	for(auto it = clients.begin(); it != clients.end(); )
+	{
+		if(!all && !it->done)
+		{
+			++it;
+			continue;
+		}
+		it->thread.join();
+		::close(it->fd);
+		it = clients.erase(it);
+	}
+}
+
+int CurveServer::run()
+{
+	struct sockaddr_un addr{};
+	if(socketPath.size() >= sizeof(addr.sun_path))
+	{
+		std::cerr << "Socket path too long: " << socketPath << std::endl;
+		return -1;
+	}
+
+	listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(listenFd < 0)
+	{
+		perror("socket");
+		return -1;
+	}
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+	unlink(socketPath.c_str());                     // a stale socket of an earlier run
+	if(bind(listenFd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(listenFd, SOMAXCONN) < 0)
+	{
+		perror("bind/listen");
+		::close(listenFd);
+		return -1;
+	}
+	std::cout << "Serving curves on " << socketPath << ", reductions on " << pool.size() << " workers." << std::endl;
+
+	while(!stopping)
+	{
+		int fd = accept(listenFd, nullptr, nullptr);
+		if(fd < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			break;
+		}
+		join_clients(false);
+		Client &client = clients.emplace_back();
+		client.fd = fd;
+		client.thread = std::thread(&CurveServer::serve_client, this, std::ref(client));
+	}
+
+	// the clients finish the request they are on, their next read sees the end of the connection
+	::close(listenFd);
+	unlink(socketPath.c_str());
+	for(auto &client : clients)
+		::shutdown(client.fd, SHUT_RD);
+	join_clients(true);
+	pool.wait();
+	return 0;
+}
+
+/* Process one curve file, following the prompts. */
+template<typename V>
+static int run_interactive(const BatchOptions &opt, bool errorBound)
+{
+	BasicProcessCurve<V> pc;
+	pc.set_engine(opt.engine);
+	pc.set_search_mode(opt.searchMode);
+	pc.set_exact_optimal(opt.exactOptimal);
+	if(pc.get_fileName() < 0)
+		return -1;
+	if(pc.parse_curve_file() < 0)
+		return -1;
+	if(pc.validate_data() < 0){
+		std::cout << "Data validation failed!" << '\n';
+		return 0;
+	}
+	if(errorBound)
+		pc.process_curve_error_bound();
+	else
+		pc.process_curve_BP();
+	pc.print_BP();
+	pc.save_processed_BP();
+
+	return 0;
+}
+
+/* Writes the instrumentation totals when main() returns, if --metrics asked for them. */
+struct MetricsReport
+{
+	bool prometheus{false};
+	std::string outFile;                            // empty: stderr
+
+	~MetricsReport()
+	{
+		if(!metricsEnabled)
+			return;
+		std::string text = prometheus ? metrics.prometheus() : metrics.json() + "\n";
+		if(outFile.empty())
+		{
+			std::cerr << text;
+			return;
+		}
+		std::ofstream outf{outFile};
+		if(!(outf << text))
+			std::cerr << "Unable to write metrics to: " << outFile << std::endl;
+	}
+};
+
+static void usage(const char *prog)
+{
+	std::cout << "Usage: " << prog << " [--engine deviation|greedy|optimal|legacy] [--search linear|bisect] [--exact] [--error-bound]\n"
+		  << "           interactive, follow the prompts (--error-bound asks for an error bound instead of a count, the breakpoints\n"
+		  << "           are then picked greedily, not always the fewest possible)\n"
+		  << "       " << prog << " --batch <directory|glob> (--count K | --error X) [--jobs N] [--out DIR]\n"
+		  << "           [--engine deviation|greedy|optimal|legacy] [--search linear|bisect]\n"
+		  << "           [--binary]\n"
+		  << "           reduce all the curve files without prompts, results are saved in DIR (default: reduced)\n"
+		  << "       " << prog << " --convert <input> <output>\n"
+		  << "           convert a curve file, output names ending with " CURVEBINEXT " are binary curve files\n"
+		  << "       " << prog << " --pareto <input> <csv>\n"
+		  << "           save breakpoints versus error of the greedy merge sequence\n"
+		  << "       " << prog << " --generate monotone|noisy|oscillating|plateau <points> <output>\n"
+		  << "           write a synthetic curve file\n"
+		  << "       " << prog << " --bench [--sizes N,N,...] [--shapes S,S,...] [--reps R] [--engine E] [--count K | --error X]\n"
+		  << "           time parse, validate and reduce on synthetic curves, one JSON object per line\n"
+		  << "       " << prog << " --compare <directory|glob> [--count K] [--strategies S,S,...] [--reps R]\n"
+		  << "           run the reduction strategies on the same curves (legacy only if named), one CSV row of time, heap, count\n"
+		  << "           and error each\n"
+		  << "       " << prog << " --stream --error X [--window W]\n"
+		  << "           reduce a curve read from stdin, picked breakpoints are written to stdout as soon as decided\n"
+		  << "       " << prog << " --serve <socket> [--jobs N]\n"
+		  << "           serve LOAD, REDUCE, INSERT, UPDATE, DELETE, LOOKUP, SAVE requests on a Unix domain socket, curves stay cached\n"
+		  << "       --engine optimal is exact up to K * n^2 / 2 = " << OPTIMALEXACTLIMIT << ", longer curves get a divide and conquer\n"
+		  << "           approximation, reported as " OPTIMALAPPROXNAME "; --exact (interactive, batch, bench, compare) solves them\n"
+		  << "           exactly too, in O(K n^2)\n"
+		  << "       --precision double|float|fixed (interactive, batch, bench, compare) stores the breakpoints as doubles, floats or int32\n"
+		  << "           fixed point with 4 decimals, the calculations are done in double. A curve with a value out of the range\n"
+		  << "           (float: 3.4e38, fixed: 214748.3647) is refused\n"
+		  << "       --metrics json|prometheus [--metrics-out FILE] (any mode) writes stage times and counters to FILE or stderr\n"
+		  << "       --simd avx2|sse2|scalar forces the slope kernels of the deviation engine (default: best supported, "
+		  << slopeKernels<double>.name << ")\n";
+}
+
+#ifndef CURVEPROCESSTEST                        // the tests have their own main()
+int main(int argc, char *argv[])
+{
+	BatchOptions opt;
+	BenchOptions bench;
+	bool batch = false, errorBound = false, benchmark = false, stream = false, compare = false;
+	size_t window = STREAMWINDOW;
+	bool serve = false;
+	std::string socketPath;
+	MetricsReport report;
+
+	for(int i = 1; i < argc; i++)
+	{
+		std::string_view arg{argv[i]};
+		bool hasValue = i + 1 < argc;
+
+		if(arg == "--batch" && hasValue)
+		{
+			batch = true;
+			opt.input = argv[++i];
+		}
+		else if(arg == "--count" && hasValue)
+			opt.numOfBreakpoints = atoi(argv[++i]);
+		else if(arg == "--error" && hasValue)
+			opt.maxError = atof(argv[++i]);
+		else if(arg == "--jobs" && hasValue)
+			opt.jobs = atoi(argv[++i]);
+		else if(arg == "--out" && hasValue)
+			opt.outDir = argv[++i];
+		else if(arg == "--engine" && hasValue)
+		{
+			if(!engine_from_name(argv[++i], opt.engine))
+			{
+				usage(argv[0]);
+				return -1;
+			}
+		}
+		else if(arg == "--search" && hasValue)
+			opt.searchMode = std::string_view{argv[++i]} == "linear" ? SearchMode::Linear : SearchMode::Bisect;
+		else if(arg == "--simd" && hasValue)
+			select_all_slope_kernels(argv[++i]);
+		else if(arg == "--binary")
+			opt.binary = true;
+		else if(arg == "--exact")
+			opt.exactOptimal = true;
+		else if(arg == "--precision" && hasValue)
+		{
+			std::string_view p{argv[++i]};
+			if(p == "float")
+				opt.precision = Precision::Float;
+			else if(p == "fixed")
+				opt.precision = Precision::Fixed;
+			else if(p == "double")
+				opt.precision = Precision::Double;
+			else
+			{
+				usage(argv[0]);
+				return -1;
+			}
+		}
+		else if(arg == "--convert" && i + 2 < argc)
+		{
+			std::string in{argv[i + 1]}, out{argv[i + 2]};
+			return convert_curve(in, out) == 0 ? 0 : 1;
+		}
+		else if(arg == "--generate" && i + 3 < argc)
+		{
+			std::string shape{argv[i + 1]}, out{argv[i + 3]};
+			if(generate_curve(shape, atol(argv[i + 2]), out) < 0)
+			{
+				std::cerr << "Unable to generate curve: " << out << std::endl;
+				return 1;
+			}
+			return 0;
+		}
+		else if(arg == "--serve" && hasValue)
+		{
+			serve = true;
+			socketPath = argv[++i];
+		}
+		else if(arg == "--stream")
+			stream = true;
+		else if(arg == "--window" && hasValue)
+			window = atol(argv[++i]);
+		else if(arg == "--bench")
+			benchmark = true;
+		else if(arg == "--compare" && hasValue)
+		{
+			compare = true;
+			opt.input = argv[++i];
+		}
+		else if(arg == "--strategies" && hasValue)
+			bench.strategies = split_list(argv[++i]);
+		else if(arg == "--sizes" && hasValue)
+		{
+			bench.sizes.clear();
+			for(auto &n : split_list(argv[++i]))
+				bench.sizes.push_back(atof(n.c_str()));     // atof, so that 1e6 works
+		}
+		else if(arg == "--shapes" && hasValue)
+			bench.shapes = split_list(argv[++i]);
+		else if(arg == "--reps" && hasValue)
+			bench.reps = std::max(1, atoi(argv[++i]));
+		else if(arg == "--pareto" && i + 2 < argc)
+		{
+			std::string in{argv[i + 1]}, out{argv[i + 2]};
+			return export_curve_pareto(in, out) == 0 ? 0 : 1;
+		}
+		else if(arg == "--error-bound")
+			errorBound = true;
+		else if(arg == "--metrics" && hasValue)
+		{
+			metricsEnabled = true;
+			report.prometheus = std::string_view{argv[++i]} == "prometheus";
+		}
+		else if(arg == "--metrics-out" && hasValue)
+			report.outFile = argv[++i];
+		else
+		{
+			usage(argv[0]);
+			return arg == "-h" || arg == "--help" ? 0 : -1;
+		}
+	}
+
+	if(serve)
+	{
+		CurveServer server(socketPath, opt.jobs ? opt.jobs : std::max(1u, std::thread::hardware_concurrency()));
+		return server.run() == 0 ? 0 : 1;
+	}
+
+	if(stream)
+	{
+		if(opt.maxError < 0)
+		{
+			usage(argv[0]);
+			return -1;
+		}
+		return run_stream(opt.maxError, window) == 0 ? 0 : 1;
+	}
+
+	if(compare)
+		return with_precision(opt.precision, [&](auto v) { return run_compare<decltype(v)>(opt, bench); }) == 0 ? 0 : 1;
+
+	if(benchmark)
+		return with_precision(opt.precision, [&](auto v) { return run_bench<decltype(v)>(opt, bench); }) == 0 ? 0 : 1;
+
+	if(batch)
+	{
+		if(opt.maxError < 0 && opt.numOfBreakpoints == 0)
+		{
+			usage(argv[0]);
+			return -1;
+		}
+		return with_precision(opt.precision, [&](auto v) { return run_batch<decltype(v)>(opt); }) == 0 ? 0 : 1;
+	}
+
+	return with_precision(opt.precision, [&](auto v) { return run_interactive<decltype(v)>(opt, errorBound); });
+}
+#endif
@@ -0,0 +1,1062 @@
+/*
+ * curveBreakpointsProcess_test.cpp
+ *
+ * Differential checks of the reduction engines of curveBreakpointsProcess.cpp: every engine is run on random and synthetic
+ * curves and its result compared with a slow, obviously right reference. The program under test is included as is, its main()
+ * is left out by CURVEPROCESSTEST.
+ *
+ *  make test
+ *
+ * or:
+ *
+ *  g++ -std=c++20 -Wall -O2 -pthread curveBreakpointsProcess_test.cpp -o curveBreakpointsProcess_test
+ *  ./curveBreakpointsProcess_test
+ *
+ * Prints one line per failed check and a summary, exits with 1 if any check failed.
+ */
+
+#define CURVEPROCESSTEST
+#define PARSECHUNKMIN 64                        // small files are parsed in chunks too
+#include "curveBreakpointsProcess.cpp"
+
+static std::atomic<int> checks{0}, failures{0};          // the server test checks from several client threads
+
+#define CHECK(cond, ...)                                                            \
+    do                                                                              \
+    {                                                                               \
+        checks++;                                                                   \
+        if(!(cond))                                                                 \
+        {                                                                           \
+            failures++;                                                             \
+            fprintf(stderr, "%s:%d: %s failed: ", __FILE__, __LINE__, #cond);        \
+            fprintf(stderr, __VA_ARGS__);                                           \
+            fprintf(stderr, "\n");                                                  \
+        }                                                                           \
+    } while (0)
+
+/* A temporary curve file, removed when it goes out of scope. */
+class TempCurve
+{
+    public:
+	explicit TempCurve(const std::string &suffix = ".curve")
+	{
+		path = (std::filesystem::temp_directory_path() / ("curve_test_" + std::to_string(getpid()) + "_"
+								   + std::to_string(next++) + suffix)).string();
+	}
+	~TempCurve() { std::filesystem::remove(path); }
+	TempCurve(const TempCurve &) = delete;
+	TempCurve &operator=(const TempCurve &) = delete;
+	const std::string &name() const { return path; }
+
+    private:
+	std::string path;
+	static inline std::atomic<int> next{0};
+};
+
+/* Write the breakpoints as a text curve file with the header of a .340 file. */
+static void write_curve(const std::string &name, const std::vector<BreakPoint> &bp)
+{
+	std::ofstream outf{name};
+	char line[96];
+
+	outf << "Sensor Model: TEST\nSerial Number: " << bp.size() << "\nData Format: 3\nSetPoint Limit: 400\n"
+	     << "Temperature coefficient: 1\nNumber of Breakpoints: " << bp.size() << "\nTemperature Unit: K\n\n";
+	for(size_t i = 0; i < bp.size(); i++)
+	{
+		snprintf(line, sizeof(line), "%ld %.10g %.10g\n", i + 1, bp[i].sensorUnit, bp[i].temp);
+		outf << line;
+	}
+}
+
+/* n breakpoints at strictly ascending sensor units, the temperature is a random walk, so the slopes change sign often. */
+static std::vector<BreakPoint> random_curve(std::mt19937_64 &rng, size_t n)
+{
+	std::uniform_real_distribution<double> step(0.1, 2), walk(-5, 5);
+	std::vector<BreakPoint> bp;
+	double x = 1, t = 100;
+
+	for(size_t i = 0; i < n; i++)
+	{
+		bp.emplace_back(round(x * 1e4) / 1e4, round(t * 1e4) / 1e4);        // what the file keeps of them
+		x += step(rng);
+		t += walk(rng);
+	}
+	return bp;
+}
+
+/* Load a curve file into pc, quietly. */
+template<typename V>
+static bool load_curve(BasicProcessCurve<V> &pc, const std::string &name)
+{
+	pc.clear();
+	pc.set_verbose(false);
+	pc.set_threads(1);
+	pc.set_fileName(name);
+	return pc.parse_curve_file() == 0 && pc.validate_data() == 0;
+}
+
+/* Indices of the picked breakpoints in the original curve, empty if a pick is not one of the breakpoints in order. */
+static std::vector<size_t> picked_indices(const std::vector<BreakPoint> &orig, const std::vector<BreakPoint> &picked)
+{
+	std::vector<size_t> idx;
+	size_t j = 0;
+
+	for(auto &p : picked)
+	{
+		while(j < orig.size() && (orig[j].sensorUnit != p.sensorUnit || orig[j].temp != p.temp))
+			j++;
+		if(j == orig.size())
+			return {};
+		idx.push_back(j++);
+	}
+	return idx;
+}
+
+/* The greedy merge without a heap: remove the interior breakpoint with the smallest slope change, recompute them all, repeat. */
+static std::vector<size_t> naive_greedy(const std::vector<BreakPoint> &bp, size_t K)
+{
+	std::vector<size_t> alive(bp.size());
+	std::iota(alive.begin(), alive.end(), 0);
+
+	auto slope = [&](size_t a, size_t b) { return (bp[b].temp - bp[a].temp) / (bp[b].sensorUnit - bp[a].sensorUnit); };
+	while(alive.size() > K)
+	{
+		size_t best = 1;
+		double bestCost = 1e300;
+		for(size_t i = 1; i + 1 < alive.size(); i++)
+		{
+			double cost = fabs(slope(alive[i - 1], alive[i]) - slope(alive[i], alive[i + 1]));
+			if(cost < bestCost)
+			{
+				bestCost = cost;
+				best = i;
+			}
+		}
+		alive.erase(alive.begin() + best);
+	}
+	return alive;
+}
+
+/* The greedy engine hits every count exactly and removes the same breakpoints as the naive greedy merge. */
+static void test_greedy_exact_count()
+{
+	std::mt19937_64 rng(2);
+	TempCurve file;
+
+	for(int c = 0; c < 30; c++)
+	{
+		std::vector<BreakPoint> bp = random_curve(rng, 3 + rng() % 150);
+		write_curve(file.name(), bp);
+		ProcessCurve pc;
+		pc.set_engine(ReduceEngine::Greedy);
+		CHECK(load_curve(pc, file.name()), "curve %d", c);
+
+		for(size_t K = 2; K <= bp.size(); K += 1 + bp.size() / 20)
+		{
+			int loops = 0;
+			double deviation = 0;
+			CHECK(pc.reduce_to_count(K, loops, deviation) == 0, "curve %d, K = %ld", c, K);
+			CHECK(pc.num_picked_BP() == K, "curve %d: %ld picked instead of %ld", c, pc.num_picked_BP(), K);
+			CHECK(picked_indices(bp, pc.picked_BP()) == naive_greedy(bp, K), "curve %d, K = %ld: not the naive greedy picks", c, K);
+		}
+	}
+}
+
+/* One pass of the deviation engine straight from its definition: from the section pair at breakpoint m, keep m if the slopes of its
+ * two sections differ by more than deviat and go on at m + 1, else merge the pair, keep m + 1 and go on at m + 2. */
+static std::vector<size_t> naive_deviation_pass(const std::vector<BreakPoint> &bp, double deviat)
+{
+	size_t n = bp.size();
+	std::vector<size_t> picks{0};
+
+	auto slope = [&](size_t a) { return (bp[a + 1].temp - bp[a].temp) / (bp[a + 1].sensorUnit - bp[a].sensorUnit); };
+	for(size_t m = 1; m + 1 < n; )
+	{
+		if(fabs(slope(m - 1) - slope(m)) > deviat)
+		{
+			picks.push_back(m);
+			m++;
+		}
+		else
+		{
+			picks.push_back(m + 1);
+			m += 2;
+		}
+	}
+	if(picks.back() != n - 1)
+		picks.push_back(n - 1);
+	return picks;
+}
+
+/* The bisection search of the deviation engine against the linear one: it reaches every count the linear search reaches, with
+ * no larger deviation, and both picks are those of one pass with the deviation they report. */
+static void test_deviation_linear_vs_bisect()
+{
+	std::mt19937_64 rng(1);
+	TempCurve file;
+	const char *shapes[] = {"monotone", "noisy", "oscillating", "plateau", "random"};
+
+	for(int c = 0; c < 100; c++)
+	{
+		size_t n = 3 + rng() % 400;
+		std::vector<BreakPoint> bp;
+		if(c % 5 == 4)
+			bp = random_curve(rng, n);
+		else
+			CHECK(generate_curve(shapes[c % 5], n, file.name()) == 0, "curve %d: %s", c, shapes[c % 5]);
+		if(!bp.empty())
+			write_curve(file.name(), bp);
+
+		ProcessCurve linear, bisect;
+		linear.set_search_mode(SearchMode::Linear);
+		bisect.set_search_mode(SearchMode::Bisect);
+		CHECK(load_curve(linear, file.name()) && load_curve(bisect, file.name()), "curve %d", c);
+		if(bp.empty())
+		{   // read the generated curve back as the file keeps it
+			bisect.pick_all_BP();
+			bp = bisect.picked_BP();
+		}
+
+		for(size_t K : {n / 2 + 2, n * 3 / 4, n - 1})
+		{
+			if(K < 3 || K >= n)
+				continue;
+			int loops = 0;
+			double devLinear = 0, devBisect = 0;
+			int retLinear = linear.reduce_to_count(K, loops, devLinear);
+			int retBisect = bisect.reduce_to_count(K, loops, devBisect);
+
+			CHECK(retBisect == 0 || retLinear != 0, "%s curve %d, K = %ld: only the linear search reaches it", shapes[c % 5], c, K);
+			if(retBisect == 0)
+			{
+				CHECK(bisect.num_picked_BP() <= K, "curve %d: %ld picked for %ld", c, bisect.num_picked_BP(), K);
+				CHECK(picked_indices(bp, bisect.picked_BP()) == naive_deviation_pass(bp, devBisect),
+				      "curve %d, K = %ld: bisection picks are not those of deviation %g", c, K, devBisect);
+			}
+			if(retLinear == 0)
+			{
+				CHECK(linear.num_picked_BP() <= K, "curve %d: %ld picked for %ld", c, linear.num_picked_BP(), K);
+				CHECK(picked_indices(bp, linear.picked_BP()) == naive_deviation_pass(bp, devLinear),
+				      "curve %d, K = %ld: linear picks are not those of deviation %g", c, K, devLinear);
+				CHECK(devBisect <= devLinear, "%s curve %d, K = %ld: bisection deviation %g above the linear %g", shapes[c % 5], c, K,
+				      devBisect, devLinear);
+			}
+		}
+	}
+}
+
+/* Every SIMD kernel this CPU supports against the scalar one on random spans, at every length up to a few vector widths past 64
+ * so that each tail and each partial word of keep bits is hit, from unaligned starts. Slopes, deviations, keep bits and the max
+ * error are equal bit for bit, the summed squares up to the order of the additions. */
+template<typename V>
+static void test_kernels_vs_scalar()
+{
+	std::mt19937_64 rng(8);
+	std::uniform_real_distribution<double> step(0, 2), walk(-5, 5);
+	const SlopeKernels<V> scalar = select_slope_kernels<V>("scalar");
+	std::vector<SlopeKernels<V>> simd;
+	for(const char *name : {"sse2", "avx2"})
+		if(SlopeKernels<V> k = select_slope_kernels<V>(name); strcmp(k.name, name) == 0)
+			simd.push_back(k);
+	if(simd.empty())
+		printf("kernels: %s: no SIMD kernel on this CPU\n", valueTypeName<V>);
+
+	auto same{ [](double a, double b) { return a == b || (std::isnan(a) && std::isnan(b)); } };
+	for(size_t n = 0; n < 150; n++)
+	{
+		size_t offset = rng() % 4;
+		std::vector<BasicBreakPoint<V>> points;
+		double x = 1, t = 100;
+		for(size_t i = 0; i < n + offset; i++)
+		{
+			points.emplace_back(round(x * 1e4) / 1e4, round(t * 1e4) / 1e4);
+			x += rng() % 16 ? step(rng) : 0;            // now and then a section of zero width
+			t += walk(rng);
+		}
+		const BasicBreakPoint<V> *bp = points.data() + offset;
+
+		std::vector<double> slope(n ? n - 1 : 0), delta(n), simdSlope(slope.size()), simdDelta(n);
+		std::vector<uint64_t> keep((n + 63) / 64), simdKeep(keep.size());
+		if(n >= 2)
+			scalar.slope(bp, n, slope.data(), delta.data());
+		double deviat = n >= 3 ? delta[1 + rng() % (n - 2)] : 1;     // a threshold equal to one of the deviations
+		if(n >= 3)
+			scalar.threshold(delta.data(), n, deviat, keep.data());
+		double x0 = n ? double(bp[0].sensorUnit) : 0, y0 = n ? double(bp[0].temp) : 0, chord = walk(rng);
+		double maxError = 0, sumSq = 0;
+		scalar.error(bp, n, x0, y0, chord, maxError, sumSq);
+
+		for(auto &k : simd)
+		{
+			if(n >= 2)
+			{
+				k.slope(bp, n, simdSlope.data(), simdDelta.data());
+				CHECK(std::equal(slope.begin(), slope.end(), simdSlope.begin(), same), "%s %s: slopes of %ld points", k.name, valueTypeName<V>, n);
+				CHECK(n < 3 || std::equal(delta.begin() + 1, delta.end() - 1, simdDelta.begin() + 1, same), "%s %s: deviations of %ld points",
+				      k.name, valueTypeName<V>, n);
+			}
+			if(n >= 3)
+			{
+				k.threshold(delta.data(), n, deviat, simdKeep.data());
+				CHECK(keep == simdKeep, "%s: keep bits of %ld points", k.name, n);
+			}
+			double simdMax = 0, simdSum = 0;
+			k.error(bp, n, x0, y0, chord, simdMax, simdSum);
+			CHECK(simdMax == maxError && fabs(simdSum - sumSq) <= 1e-12 * std::max(1.0, sumSq), "%s %s: error of %ld points: %g %g, scalar %g %g",
+			      k.name, valueTypeName<V>, n, simdMax, simdSum, maxError, sumSq);
+		}
+	}
+}
+
+/* Every row of the Pareto export has the max and rms error verify_reduction() measures on the greedy reduction to its count. */
+static void test_pareto_vs_verify()
+{
+	std::mt19937_64 rng(9);
+	TempCurve file, csv(".csv");
+
+	for(int c = 0; c < 20; c++)
+	{
+		std::vector<BreakPoint> bp = random_curve(rng, 3 + rng() % 300);
+		write_curve(file.name(), bp);
+		ProcessCurve pc;
+		pc.set_engine(ReduceEngine::Greedy);
+		CHECK(load_curve(pc, file.name()), "curve %d", c);
+		CHECK(pc.export_pareto(csv.name()) == 0, "curve %d: no Pareto export", c);
+
+		std::ifstream inf{csv.name()};
+		std::string line;
+		size_t rows = 0;
+		std::getline(inf, line);                    // column names
+		while(std::getline(inf, line))
+		{
+			size_t K = 0;
+			double cost, maxCost, maxError, rmsError;
+			CHECK(sscanf(line.c_str(), "%ld,%lf,%lf,%lf,%lf", &K, &cost, &maxCost, &maxError, &rmsError) == 5, "curve %d: %s", c,
+			      line.c_str());
+			rows++;
+			int loops = 0;
+			double deviation = 0;
+			ReductionError err;
+			pc.reduce_to_count(K, loops, deviation);
+			pc.verify_reduction(err);
+			CHECK(fabs(maxError - err.maxError) <= 1e-9 * std::max(1.0, err.maxError)
+			      && fabs(rmsError - err.rmsError) <= 1e-6 * std::max(1.0, err.rmsError),
+			      "curve %d, K = %ld: Pareto error %g rms %g, measured %g rms %g", c, K, maxError, rmsError, err.maxError, err.rmsError);
+		}
+		CHECK(rows == bp.size() - 1, "curve %d: %ld rows for %ld breakpoints", c, rows, bp.size());
+	}
+}
+
+/* Summed squared interpolation error of the chords between the picks against all the breakpoints, straight from the definition. */
+static double picks_sq_error(const std::vector<BreakPoint> &bp, const std::vector<size_t> &picks)
+{
+	double sum = 0;
+	for(size_t p = 0; p + 1 < picks.size(); p++)
+	{
+		const BreakPoint &a = bp[picks[p]], &b = bp[picks[p + 1]];
+		for(size_t k = picks[p] + 1; k < picks[p + 1]; k++)
+		{
+			double d = bp[k].temp - (a.temp + (b.temp - a.temp) * (bp[k].sensorUnit - a.sensorUnit) / (b.sensorUnit - a.sensorUnit));
+			sum += d * d;
+		}
+	}
+	return sum;
+}
+
+/* The smallest summed squared error of K picks, by the plain dynamic programming over every split point, each chord error summed
+ * breakpoint by breakpoint. O(K n^3). */
+static double exact_min_sq_error(const std::vector<BreakPoint> &bp, size_t K)
+{
+	size_t n = bp.size();
+	const double inf = std::numeric_limits<double>::infinity();
+	std::vector<double> prev(n, inf), cur(n);
+
+	prev[0] = 0;
+	for(size_t k = 2; k <= K; k++)
+	{
+		std::fill(cur.begin(), cur.end(), inf);
+		for(size_t j = 1; j < n; j++)
+			for(size_t i = 0; i < j; i++)
+				if(prev[i] < inf)
+					cur[j] = std::min(cur[j], prev[i] + picks_sq_error(bp, {i, j}));
+		prev.swap(cur);
+	}
+	return prev[n - 1];
+}
+
+/* The optimal engine reaches the error of the plain dynamic programming and its picks have the error it reports. A curve too long
+ * for the exact search is flagged approximate, and forcing the exact search is never worse. */
+static void test_optimal_vs_exact_dp()
+{
+	std::mt19937_64 rng(3);
+	TempCurve file;
+
+	for(int c = 0; c < 20; c++)
+	{
+		std::vector<BreakPoint> bp = random_curve(rng, 3 + rng() % 50);
+		write_curve(file.name(), bp);
+		ProcessCurve pc;
+		pc.set_engine(ReduceEngine::Optimal);
+		CHECK(load_curve(pc, file.name()), "curve %d", c);
+
+		for(size_t K = 2; K <= bp.size(); K += 1 + bp.size() / 8)
+		{
+			int loops = 0;
+			double sqError = 0;
+			CHECK(pc.reduce_to_count(K, loops, sqError) == 0, "curve %d, K = %ld", c, K);
+			CHECK(!pc.is_approximate(), "curve %d, K = %ld: approximate", c, K);
+			std::vector<size_t> picks = picked_indices(bp, pc.picked_BP());
+			double exact = exact_min_sq_error(bp, K), got = picks_sq_error(bp, picks);
+			CHECK(picks.size() == K, "curve %d: %ld picked instead of %ld", c, picks.size(), K);
+			CHECK(fabs(got - exact) <= 1e-6 * std::max(1.0, exact), "curve %d, K = %ld: error %.9g, optimum %.9g", c, K, got, exact);
+			CHECK(fabs(sqError - got) <= 1e-6 * std::max(1.0, got), "curve %d, K = %ld: reports %.9g, picks have %.9g", c, K, sqError, got);
+		}
+	}
+
+	// 100 * 2100^2 / 2 is above OPTIMALEXACTLIMIT
+	std::vector<BreakPoint> bp = random_curve(rng, 2100);
+	write_curve(file.name(), bp);
+	ProcessCurve pc;
+	pc.set_engine(ReduceEngine::Optimal);
+	CHECK(load_curve(pc, file.name()), "long curve");
+	int loops = 0;
+	double approx = 0, exact = 0;
+	CHECK(pc.reduce_to_count(100, loops, approx) == 0 && pc.is_approximate(), "long curve: not flagged approximate");
+	pc.set_exact_optimal(true);
+	CHECK(pc.reduce_to_count(100, loops, exact) == 0 && !pc.is_approximate(), "long curve: forced exact flagged approximate");
+	CHECK(exact <= approx * (1 + 1e-9), "long curve: exact %.9g above the approximation %.9g", exact, approx);
+}
+
+/* Largest interpolation error of the chords between the picks at the breakpoints in between. */
+static double picks_max_error(const std::vector<BreakPoint> &bp, const std::vector<size_t> &picks)
+{
+	double worst = 0;
+	for(size_t p = 0; p + 1 < picks.size(); p++)
+	{
+		const BreakPoint &a = bp[picks[p]], &b = bp[picks[p + 1]];
+		for(size_t k = picks[p] + 1; k < picks[p + 1]; k++)
+			worst = std::max(worst, fabs(bp[k].temp - (a.temp + (b.temp - a.temp) * (bp[k].sensorUnit - a.sensorUnit)
+									   / (b.sensorUnit - a.sensorUnit))));
+	}
+	return worst;
+}
+
+/* The fewest breakpoints that keep the curve within maxError, by a shortest path over every chord that stays within it. O(n^3). */
+static size_t exact_min_breakpoints(const std::vector<BreakPoint> &bp, double maxError)
+{
+	size_t n = bp.size();
+	std::vector<size_t> dist(n, SIZE_MAX);
+
+	dist[0] = 1;
+	for(size_t i = 0; i < n; i++)
+		for(size_t j = i + 1; j < n; j++)
+			if(dist[i] + 1 < dist[j] && picks_max_error(bp, {i, j}) <= maxError)
+				dist[j] = dist[i] + 1;
+	return dist[n - 1];
+}
+
+/* The error bound engine and the streaming reducer with a small window keep every curve within the bound, first and last
+ * breakpoints picked, and never pick fewer breakpoints than the minimum. Both are greedy, so they are approximate: picking more
+ * than the minimum is allowed, the totals are printed. A small window does not cut a straight run, only its end points are
+ * picked. */
+static void test_error_bound()
+{
+	std::mt19937_64 rng(4);
+	TempCurve file;
+	size_t greedy = 0, fewest = 0;
+
+	for(int c = 0; c < 60; c++)
+	{
+		std::vector<BreakPoint> bp = random_curve(rng, 2 + rng() % 80);
+		write_curve(file.name(), bp);
+		ProcessCurve pc;
+		CHECK(load_curve(pc, file.name()), "curve %d", c);
+
+		for(double maxError : {0.0, 0.5, 2.0, 10.0, 1e9})
+		{
+			CHECK(pc.reduce_error_bound(maxError) == 0, "curve %d, bound %g", c, maxError);
+			std::vector<size_t> picks = picked_indices(bp, pc.picked_BP());
+			size_t minimum = exact_min_breakpoints(bp, maxError);
+			CHECK(picks.size() == pc.num_picked_BP() && picks.front() == 0 && picks.back() == bp.size() - 1,
+			      "curve %d, bound %g: not a subset with both end points", c, maxError);
+			CHECK(picks_max_error(bp, picks) <= maxError + 1e-9, "curve %d, bound %g: error %g", c, maxError, picks_max_error(bp, picks));
+			CHECK(picks.size() >= minimum, "curve %d, bound %g: %ld picked, below the minimum %ld", c, maxError, picks.size(), minimum);
+			greedy += picks.size();
+			fewest += minimum;
+
+			for(size_t window : {1, 3, 16})
+			{
+				std::vector<size_t> streamed;
+				StreamingReducer reducer(maxError, window, [&](const BreakPoint &, size_t seq, size_t) { streamed.push_back(seq); });
+				for(auto &p : bp)
+					reducer.push(p);
+				reducer.finish();
+				CHECK(streamed.front() == 0 && streamed.back() == bp.size() - 1 && std::is_sorted(streamed.begin(), streamed.end()),
+				      "curve %d, bound %g, window %ld: picks out of order", c, maxError, window);
+				CHECK(picks_max_error(bp, streamed) <= maxError + 1e-9, "curve %d, bound %g, window %ld: error %g", c, maxError, window,
+				      picks_max_error(bp, streamed));
+			}
+		}
+	}
+
+	std::vector<BreakPoint> line;
+	for(int i = 0; i < 500; i++)
+		line.push_back(BreakPoint(i * 3, 2 * i - 40));
+	for(size_t window : {1, 3, 16})
+	{
+		std::vector<size_t> streamed;
+		StreamingReducer reducer(0.5, window, [&](const BreakPoint &, size_t seq, size_t) { streamed.push_back(seq); });
+		for(auto &p : line)
+			reducer.push(p);
+		reducer.finish();
+		CHECK(streamed == std::vector<size_t>({0, line.size() - 1}), "straight run, window %ld: %ld picked", window, streamed.size());
+	}
+	printf("error bound: %ld breakpoints picked greedily, %ld at the minimum\n", greedy, fewest);
+}
+
+/* A curve saved as a binary file loads back with the same breakpoints, bit for bit, in every precision; a reduced curve too, with
+ * its breakpoint count in the header. A truncated file is rejected. */
+template<typename V>
+static void test_binary_round_trip()
+{
+	std::mt19937_64 rng(7);
+	TempCurve text, bin(CURVEBINEXT), again(CURVEBINEXT);
+
+	for(int c = 0; c < 10; c++)
+	{
+		write_curve(text.name(), random_curve(rng, 3 + rng() % 2000));
+		BasicProcessCurve<V> pc, loaded;
+		CHECK(load_curve(pc, text.name()), "%s curve %d", typeid(V).name(), c);
+		pc.pick_all_BP();
+		pc.set_output_file(bin.name());
+		CHECK(pc.save_processed_BP() == 0, "%s curve %d: not saved", typeid(V).name(), c);
+		CHECK(load_curve(loaded, bin.name()), "%s curve %d: binary not loaded", typeid(V).name(), c);
+		loaded.pick_all_BP();
+		CHECK(loaded.num_picked_BP() == pc.num_picked_BP()
+		      && std::equal(pc.picked_BP().begin(), pc.picked_BP().end(), loaded.picked_BP().begin(),
+				    [](auto &a, auto &b) { return a.sensorUnit == b.sensorUnit && a.temp == b.temp; }),
+		      "%s curve %d: breakpoints changed", typeid(V).name(), c);
+
+		// a reduced curve
+		int loops = 0;
+		double deviation = 0;
+		pc.set_engine(ReduceEngine::Greedy);
+		CHECK(pc.reduce_to_count(std::min<size_t>(20, pc.num_orig_BP()), loops, deviation) >= 0, "%s curve %d", typeid(V).name(), c);
+		pc.set_output_file(again.name());
+		CHECK(pc.save_processed_BP() == 0, "%s curve %d: reduced curve not saved", typeid(V).name(), c);
+		CHECK(load_curve(loaded, again.name()), "%s curve %d: reduced binary not loaded", typeid(V).name(), c);
+		loaded.pick_all_BP();
+		CHECK(loaded.num_picked_BP() == pc.num_picked_BP()
+		      && std::equal(pc.picked_BP().begin(), pc.picked_BP().end(), loaded.picked_BP().begin(),
+				    [](auto &a, auto &b) { return a.sensorUnit == b.sensorUnit && a.temp == b.temp; }),
+		      "%s curve %d: reduced breakpoints changed", typeid(V).name(), c);
+		std::ifstream inf{again.name(), std::ios::binary};
+		std::string data{std::istreambuf_iterator<char>(inf), {}};
+		CHECK(data.find("Number of Breakpoints: " + std::to_string(pc.num_picked_BP())) != std::string::npos,
+		      "%s curve %d: breakpoint count not in the header", typeid(V).name(), c);
+
+	}
+
+	std::filesystem::resize_file(bin.name(), std::filesystem::file_size(bin.name()) / 2);
+	BasicProcessCurve<V> truncated;
+	CHECK(!load_curve(truncated, bin.name()), "%s: truncated binary loaded", typeid(V).name());
+}
+
+/* Linear interpolation of the section holding the reading, found by a linear scan, extrapolated outside the curve. */
+static double naive_lookup(const std::vector<BreakPoint> &bp, double sensorUnit)
+{
+	size_t s = 0;
+	while(s + 2 < bp.size() && bp[s + 1].sensorUnit <= sensorUnit)
+		s++;
+	double dx = bp[s + 1].sensorUnit - bp[s].sensorUnit;
+	return bp[s].temp + (dx > 0 ? (bp[s + 1].temp - bp[s].temp) / dx : 0) * (sensorUnit - bp[s].sensorUnit);
+}
+
+/* The breakpoint section parsed in chunks on 2 to 8 threads gives the breakpoints of the parse on one thread. The section is
+ * sprinkled with comment lines, blank lines, CRLF line ends, 2 token lines and tabs, so that the chunk boundaries fall on every
+ * kind of line and inside them. A header line among the breakpoints is refused by both. */
+static void test_parallel_parse()
+{
+	std::mt19937_64 rng(12);
+	TempCurve file;
+	std::uniform_real_distribution<double> value(0, 500);
+	char line[96];
+	std::ostringstream refused;                     // the parser's message of the misplaced header, the CHECKs use stderr directly
+	std::streambuf *cerrBuf = std::cerr.rdbuf(refused.rdbuf());
+
+	for(int c = 0; c < 200; c++)
+	{
+		size_t n = 2 + rng() % 300;
+		bool misplacedHeader = c % 10 == 9;
+		std::string text = "Sensor Model: TEST\nSerial Number: 12\nData Format: 3\nSetPoint Limit: 400\n"
+				   "Temperature coefficient: 1\nNumber of Breakpoints: " + std::to_string(n) + "\nTemperature Unit: K\n\n";
+		double x = 0;
+		for(size_t i = 0; i < n; i++)
+		{
+			switch(rng() % 8)
+			{
+			case 0:
+				text += "# comment line " + std::to_string(i) + "\n";
+				break;
+			case 1:
+				text += rng() % 2 ? "\n" : "   \t # indented comment\r\n";
+				break;
+			}
+			if(misplacedHeader && i == n / 2)
+				text += "Temperature Unit: K\n";
+			x += 0.001 + value(rng) / 100;
+			if(rng() % 4 == 0)
+				snprintf(line, sizeof(line), "%.10g\t%.6f\r\n", x, value(rng));
+			else
+				snprintf(line, sizeof(line), "%ld  %.10g %.6f\n", i + 1, x, value(rng));
+			text += line;
+		}
+		if(rng() % 2)
+			text.pop_back();                            // no newline after the last line
+		std::ofstream{file.name()} << text;
+
+		ProcessCurve one;
+		one.set_verbose(false);
+		one.set_threads(1);
+		one.set_fileName(file.name());
+		int ret = one.parse_curve_file();
+		CHECK(ret == (misplacedHeader ? -1 : 0), "curve %d: parse on one thread returned %d", c, ret);
+		one.pick_all_BP();
+		CHECK(misplacedHeader || one.num_orig_BP() == n, "curve %d: %ld breakpoints of %ld", c, one.num_orig_BP(), n);
+
+		for(unsigned threads = 2; threads <= 8; threads++)
+		{
+			ProcessCurve many;
+			many.set_verbose(false);
+			many.set_threads(threads);
+			many.set_fileName(file.name());
+			CHECK(many.parse_curve_file() == ret, "curve %d, %u threads: parse did not return %d", c, threads, ret);
+			if(ret < 0)
+				continue;
+			many.pick_all_BP();
+			bool same = many.num_picked_BP() == one.num_picked_BP()
+				    && std::equal(many.picked_BP().begin(), many.picked_BP().end(), one.picked_BP().begin(),
+						  [](auto &a, auto &b) { return a.sensorUnit == b.sensorUnit && a.temp == b.temp; });
+			CHECK(same, "curve %d, %u threads: %ld breakpoints, %ld on one thread", c, threads,
+			      many.num_orig_BP(), one.num_orig_BP());
+		}
+	}
+	std::cerr.rdbuf(cerrBuf);
+}
+
+/* Both lookup modes, one reading and batches, give the naive interpolation for readings inside, on and outside the curve, with
+ * coarse and fine grids. NaN and infinite readings give NaN or an infinite value, without reading outside the tables. */
+static void test_lookup_vs_naive()
+{
+	std::mt19937_64 rng(13);
+	const double inf = std::numeric_limits<double>::infinity();
+
+	for(int c = 0; c < 40; c++)
+	{
+		std::vector<BreakPoint> bp = random_curve(rng, 2 + rng() % 300);
+		if(c % 4 == 0)
+			bp.insert(bp.begin() + bp.size() / 2, bp[bp.size() / 2]);        // a repeated sensor unit, a section of zero width
+		double lo = bp.front().sensorUnit, hi = bp.back().sensorUnit, span = hi - lo;
+		std::uniform_real_distribution<double> reading(lo - span / 4, hi + span / 4);
+		std::vector<double> in;
+		for(int i = 0; i < 500; i++)
+			in.push_back(reading(rng));
+		for(auto &p : bp)
+			in.push_back(p.sensorUnit);
+		in.insert(in.end(), {lo - 1e300, hi + 1e300, -1e308, 1e308});
+
+		for(auto mode : {CurveLookup::Mode::Eytzinger, CurveLookup::Mode::Grid})
+		{
+			for(size_t cells : {0, 1, 7, 10000})
+			{
+				CurveLookup lk;
+				CHECK(lk.build(bp, mode, cells) == 0, "curve %d", c);
+				std::vector<double> out(in.size());
+				lk.lookup(in, out);
+				for(size_t i = 0; i < in.size(); i++)
+				{
+					double want = naive_lookup(bp, in[i]), got = lk.lookup(in[i]);
+					double tol = 1e-9 * std::max(1.0, fabs(want));
+					CHECK(fabs(got - want) <= tol || got == want, "curve %d, mode %d, %ld cells: %.17g gives %.17g, not %.17g", c, (int)mode,
+					      cells, in[i], got, want);
+					CHECK(out[i] == got || (std::isnan(out[i]) && std::isnan(got)), "curve %d, mode %d: batch %.17g, single %.17g", c,
+					      (int)mode, out[i], got);
+				}
+				for(double odd : {std::numeric_limits<double>::quiet_NaN(), inf, -inf})
+				{
+					double got = lk.lookup(odd);
+					CHECK(std::isnan(got) || std::isinf(got), "curve %d, mode %d: %g gives %g", c, (int)mode, odd, got);
+				}
+			}
+		}
+	}
+}
+
+/* A curve with a value beyond the range of the precision is refused, text or binary, and so is an edit with such a value; values
+ * in range are kept. */
+template<typename V>
+static void test_value_range(double tooBig)
+{
+	TempCurve text, bin(CURVEBINEXT);
+	std::vector<BreakPoint> bp{{1, 10}, {2, tooBig}, {3, 12}};
+	BasicProcessCurve<V> pc;
+
+	write_curve(text.name(), bp);
+	CHECK(!load_curve(pc, text.name()), "%s: %g loaded", valueTypeName<V>, tooBig);
+	ProcessCurve wide;
+	CHECK(load_curve(wide, text.name()), "double: %g not loaded", tooBig);
+	wide.pick_all_BP();
+	wide.set_output_file(bin.name());
+	CHECK(wide.save_processed_BP() == 0, "double: not saved");
+	CHECK(!load_curve(pc, bin.name()), "%s: %g loaded from a binary file", valueTypeName<V>, tooBig);
+
+	bp[1].temp = 11;
+	write_curve(text.name(), bp);
+	CHECK(load_curve(pc, text.name()), "%s: curve in range not loaded", valueTypeName<V>);
+	CHECK(pc.insert_BP(2.5, tooBig) < 0 && pc.update_BP(1, 2, -tooBig) < 0 && pc.insert_BP(tooBig, 1) < 0 && pc.num_orig_BP() == 3,
+	      "%s: edit with %g accepted", valueTypeName<V>, tooBig);
+	CHECK(pc.insert_BP(2.5, 11.5) == 0 && pc.num_orig_BP() == 4, "%s: edit in range refused", valueTypeName<V>);
+}
+
+/* Random inserts, updates, deletes and appends of a curve, the same edits are made to a copy of the breakpoints. After every edit
+ * the picks are those of a new reduction of the edited curve: with an error bound, to a count, or all of them. */
+static void test_edits_vs_recompute()
+{
+	std::mt19937_64 rng(19);
+	TempCurve file;
+	auto rounded{ [](double v) { return round(v * 1e4) / 1e4; } };
+	struct Mode
+	{
+		double bound;                               // >= 0: error bound reduction
+		size_t count;                               // else to this count, SIZE_MAX: all picked
+		ReduceEngine engine;
+	};
+	const Mode modes[] = {{0.5, 0, ReduceEngine::Deviation}, {3, 0, ReduceEngine::Deviation}, {-1, 30, ReduceEngine::Greedy},
+			      {-1, 110, ReduceEngine::Deviation}, {-1, 20, ReduceEngine::Optimal}, {-1, SIZE_MAX, ReduceEngine::Deviation}};
+
+	for(int c = 0; c < 12; c++)
+	{
+		for(auto &mode : modes)
+		{
+			std::vector<BreakPoint> bp = random_curve(rng, 100 + rng() % 100);
+			write_curve(file.name(), bp);
+			ProcessCurve pc;
+			pc.set_engine(mode.engine);
+			CHECK(load_curve(pc, file.name()), "curve %d", c);
+			int loops = 0;
+			double deviation = 0;
+			if(mode.bound >= 0)
+				pc.reduce_error_bound(mode.bound);
+			else if(mode.count == SIZE_MAX)
+				pc.pick_all_BP();
+			else
+				pc.reduce_to_count(mode.count, loops, deviation);
+
+			for(int edit = 0; edit < 40; edit++)
+			{
+				size_t i = rng() % bp.size();
+				double lo = i ? bp[i - 1].sensorUnit : bp[i].sensorUnit - 1, hi = i + 1 < bp.size() ? bp[i + 1].sensorUnit : lo + 2;
+				double x = rounded(std::uniform_real_distribution<double>(lo, hi)(rng));
+				double t = rounded(std::uniform_real_distribution<double>(50, 150)(rng));
+				int ret = 0, kind = rng() % 4;
+				if(kind == 0 && x > bp[i].sensorUnit)
+				{   // insert behind breakpoint i
+					ret = pc.insert_BP(x, t);
+					bp.insert(std::upper_bound(bp.begin(), bp.end(), x, [](double v, const BreakPoint &b) { return v < b.sensorUnit; }),
+						  BreakPoint(x, t));
+				}
+				else if(kind == 1 && x >= lo && x <= hi)
+				{
+					ret = pc.update_BP(i, x, t);
+					bp[i] = BreakPoint(x, t);
+				}
+				else if(kind == 2 && bp.size() > 4)
+				{
+					ret = pc.delete_BP(i);
+					bp.erase(bp.begin() + i);
+				}
+				else
+				{   // append a tail
+					x = rounded(bp.back().sensorUnit + 0.5);
+					ret = pc.insert_BP(x, t);
+					bp.emplace_back(x, t);
+				}
+				CHECK(ret >= 0, "curve %d, edit %d: refused", c, edit);
+
+				write_curve(file.name(), bp);
+				ProcessCurve fresh;
+				fresh.set_engine(mode.engine);
+				load_curve(fresh, file.name());
+				if(mode.bound >= 0)
+					fresh.reduce_error_bound(mode.bound);
+				else if(mode.count == SIZE_MAX || ret == 1)
+					fresh.pick_all_BP();
+				else
+					fresh.reduce_to_count(mode.count, loops, deviation);
+				bool same = pc.num_picked_BP() == fresh.num_picked_BP()
+					    && std::equal(pc.picked_BP().begin(), pc.picked_BP().end(), fresh.picked_BP().begin(),
+							  [](auto &a, auto &b) { return a.sensorUnit == b.sensorUnit && a.temp == b.temp; });
+				CHECK(same, "curve %d, bound %g, count %ld, engine %s, edit %d (%d at %ld): %ld picked, %ld by a new reduction", c,
+				      mode.bound, mode.count, engine_name(mode.engine), edit, kind, i, pc.num_picked_BP(), fresh.num_picked_BP());
+				if(mode.bound < 0 && mode.count < bp.size() && ret == 0)
+					CHECK(pc.num_picked_BP() == mode.count || mode.engine == ReduceEngine::Deviation,
+					      "curve %d, edit %d: %ld picked instead of %ld", c, edit, pc.num_picked_BP(), mode.count);
+			}
+		}
+	}
+}
+
+/* Several client threads submit to one pool at the same time, each waits for the reply of its task like a server connection
+ * does: every task runs exactly once and every client gets its own reply. */
+static void test_pool_concurrent_submit()
+{
+	constexpr int clients = 8, requests = 2000;
+	WorkStealingPool pool(3);
+	std::vector<std::atomic<int>> runs(clients * requests);
+	std::atomic<int> wrongReplies{0};
+	std::vector<std::thread> threads;
+
+	for(int c = 0; c < clients; c++)
+		threads.emplace_back([&, c]
+		{
+			for(int r = 0; r < requests; r++)
+			{
+				std::promise<int> reply;
+				std::future<int> done = reply.get_future();
+				int id = c * requests + r;
+				pool.submit([&, id](unsigned)
+				{
+					runs[id]++;
+					reply.set_value(id);
+				});
+				if(done.get() != id)
+					wrongReplies++;
+			}
+		});
+	for(auto &t : threads)
+		t.join();
+	pool.wait();
+
+	CHECK(wrongReplies == 0, "%d replies to the wrong client", wrongReplies.load());
+	CHECK(std::all_of(runs.begin(), runs.end(), [](auto &n) { return n == 1; }), "a task did not run exactly once");
+}
+
+/* One request line over a connected socket, the reply without its newline, empty if the connection is gone. */
+static std::string request(int fd, const std::string &line)
+{
+	std::string req = line + "\n", reply;
+	char c;
+
+	if(send(fd, req.data(), req.size(), MSG_NOSIGNAL) < 0)
+		return "";
+	while(recv(fd, &c, 1, 0) == 1 && c != '\n')
+		reply += c;
+	return reply;
+}
+
+static int connect_server(const std::string &path)
+{
+	struct sockaddr_un addr{};
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+	for(int tries = 0; tries < 500; tries++)
+	{                                               // the server may not listen yet
+		int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if(connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0)
+			return fd;
+		::close(fd);
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	return -1;
+}
+
+/* Round trips with the server on a temporary socket: the replies to LOAD, REDUCE, edits and LOOKUP are those of the same steps
+ * made on a ProcessCurve, and two clients do it at the same time, on curves of their own and on a shared one. */
+static void test_server_round_trip()
+{
+	TempCurve socketFile(".sock"), shared;
+	std::mt19937_64 rng(16);
+	std::vector<BreakPoint> sharedBP = random_curve(rng, 300);
+	write_curve(shared.name(), sharedBP);
+
+	CurveServer server(socketFile.name(), 2);
+	int served = -1;
+	std::thread serverThread([&] { served = server.run(); });
+
+	auto client{ [&](int id, uint64_t seed)
+	{
+		std::mt19937_64 rng(seed);
+		TempCurve file;
+		std::vector<BreakPoint> bp = random_curve(rng, 200 + rng() % 200);
+		write_curve(file.name(), bp);
+		std::string name = "c" + std::to_string(id);
+		char expected[160];
+
+		int fd = connect_server(socketFile.name());
+		CHECK(fd >= 0, "client %d: unable to connect", id);
+		if(fd < 0)
+			return;
+		snprintf(expected, sizeof(expected), "OK %ld breakpoints", bp.size());
+		CHECK(request(fd, "LOAD " + name + " " + file.name()) == expected, "client %d: LOAD", id);
+		CHECK(request(fd, "LOAD shared " + shared.name()).starts_with("OK"), "client %d: LOAD shared", id);
+
+		ProcessCurve pc;
+		load_curve(pc, file.name());
+		pc.set_engine(ReduceEngine::Greedy);
+		int loops = 0;
+		double deviation = 0;
+		for(int round = 0; round < 20; round++)
+		{
+			size_t count = 20 + rng() % 40;
+			std::string reply = request(fd, "REDUCE " + name + " COUNT " + std::to_string(count) + " greedy");
+			pc.reduce_to_count(count, loops, deviation);
+			snprintf(expected, sizeof(expected), "OK %ld breakpoints ", count);
+			CHECK(reply.starts_with(expected), "client %d: %s after REDUCE to %ld", id, reply.c_str(), count);
+
+			// an insert past the end, an update in place and a delete, mirrored on pc
+			double x = bp.back().sensorUnit + 1, t = 100 + round;
+			size_t i = 1 + rng() % (bp.size() - 2);
+			double lo = bp[i - 1].sensorUnit, hi = bp[i + 1].sensorUnit;
+			char line[160];
+			snprintf(line, sizeof(line), "INSERT %s %.10g %.10g", name.c_str(), x, t);
+			reply = request(fd, line);
+			pc.insert_BP(x, t);
+			bp.emplace_back(x, t);
+			snprintf(expected, sizeof(expected), "OK %ld breakpoints %ld picked", pc.num_orig_BP(), pc.num_picked_BP());
+			CHECK(reply == expected, "client %d: %s instead of %s", id, reply.c_str(), expected);
+
+			snprintf(line, sizeof(line), "UPDATE %s %ld %.10g %.10g", name.c_str(), i, (lo + hi) / 2, t);
+			reply = request(fd, line);
+			pc.update_BP(i, (lo + hi) / 2, t);
+			bp[i] = BreakPoint((lo + hi) / 2, t);
+			snprintf(expected, sizeof(expected), "OK %ld breakpoints %ld picked", pc.num_orig_BP(), pc.num_picked_BP());
+			CHECK(reply == expected, "client %d: %s instead of %s", id, reply.c_str(), expected);
+
+			reply = request(fd, "DELETE " + name + " " + std::to_string(i));
+			pc.delete_BP(i);
+			bp.erase(bp.begin() + i);
+			snprintf(expected, sizeof(expected), "OK %ld breakpoints %ld picked", pc.num_orig_BP(), pc.num_picked_BP());
+			CHECK(reply == expected, "client %d: %s instead of %s", id, reply.c_str(), expected);
+
+			CurveLookup lookup(pc.picked_BP());
+			double reading = bp[i].sensorUnit + 0.25;
+			snprintf(line, sizeof(line), "LOOKUP %s %.10g", name.c_str(), reading);
+			snprintf(expected, sizeof(expected), "OK %.10g", lookup.lookup(reading));
+			reply = request(fd, line);
+			CHECK(reply == expected, "client %d: %s instead of %s", id, reply.c_str(), expected);
+
+			CHECK(request(fd, "LOOKUP shared 10 20 30").starts_with("OK "), "client %d: LOOKUP shared", id);
+			CHECK(request(fd, "REDUCE shared ERROR 2").starts_with("OK "), "client %d: REDUCE shared", id);
+		}
+		CHECK(request(fd, "DELETE " + name + " x") == "ERR invalid index x", "client %d: DELETE x", id);
+		CHECK(request(fd, "QUIT") == "OK bye", "client %d: QUIT", id);
+		::close(fd);
+	} };
+
+	std::thread first(client, 1, 161), second(client, 2, 162);
+	first.join();
+	second.join();
+
+	int fd = connect_server(socketFile.name());
+	CHECK(request(fd, "SHUTDOWN") == "OK shutting down", "SHUTDOWN");
+	::close(fd);
+	serverThread.join();
+	CHECK(served == 0, "server returned %d", served);
+}
+
+/* The legacy engine against the C process_curve() it is a port of: the C program is run on the same curve file with its prompts
+ * answered on stdin, its picks are compared with those of the legacy engine as printed, with 6 decimals. The C parser takes only
+ * unsigned numbers, its header fields by their token count, at most 200 breakpoints and loops forever on a count it can not reach,
+ * so the curves keep to that. Skipped if process_curve_c is not built, "make test" builds it. */
+static void test_legacy_vs_c()
+{
+	if(access("./process_curve_c", X_OK) != 0)
+	{
+		printf("legacy vs C: skipped, ./process_curve_c is not built\n");
+		return;
+	}
+
+	std::mt19937_64 rng(20);
+	TempCurve file;
+	char line[256];
+
+	for(int c = 0; c < 8; c++)
+	{
+		std::vector<BreakPoint> bp;
+		do
+			bp = random_curve(rng, 100 + rng() % 101);
+		while(std::any_of(bp.begin(), bp.end(), [](auto &b) { return b.temp <= 0; }));
+		size_t count = bp.size() * 3 / 4;
+
+		{
+			std::ofstream outf{file.name()};
+			outf << "Sensor Model: TEST\nSerial Number: " << c << "\nData Format: 4 (Log Ohms /Kelvin)\nSetPoint Limit: 400 (Kelvin)\n"
+			     << "Temperature Coefficient: 1 (Negative)\nNumber of Breakpoints: " << bp.size() << "\nTemperature Unit: (K)\n\n";
+			for(size_t i = 0; i < bp.size(); i++)
+			{
+				snprintf(line, sizeof(line), "%ld %.4f %.4f\n", i + 1, bp[i].sensorUnit, bp[i].temp);
+				outf << line;
+			}
+		}
+
+		std::vector<std::pair<std::string, std::string>> cPicks;
+		std::string cmd = "printf '" + file.name() + "\\n" + std::to_string(count) + "\\nn\\n' | ./process_curve_c";
+		FILE *out = popen(cmd.c_str(), "r");
+		CHECK(out != nullptr, "curve %d: unable to run %s", c, cmd.c_str());
+		if(!out)
+			return;
+		while(fgets(line, sizeof(line), out))
+		{
+			int j;
+			char unit[64], temp[64];
+			if(sscanf(line, "Picked breakpoint %d: sensorUnit = %63[^,], temperature = %63s", &j, unit, temp) == 3)
+				cPicks.emplace_back(unit, temp);
+		}
+		pclose(out);
+
+		ProcessCurve pc;
+		pc.set_engine(ReduceEngine::Legacy);
+		CHECK(load_curve(pc, file.name()), "curve %d", c);
+		int loops = 0;
+		double deviation = 0;
+		CHECK(pc.reduce_to_count(count, loops, deviation) == 0, "curve %d: legacy engine did not get down to %ld", c, count);
+
+		bool same = pc.num_picked_BP() == cPicks.size();
+		for(size_t i = 0; same && i < cPicks.size(); i++)
+		{
+			char unit[64], temp[64];
+			snprintf(unit, sizeof(unit), "%f", pc.picked_BP()[i].sensorUnit);
+			snprintf(temp, sizeof(temp), "%f", pc.picked_BP()[i].temp);
+			same = cPicks[i].first == unit && cPicks[i].second == temp;
+		}
+		CHECK(same, "curve %d, %ld breakpoints to %ld: legacy engine picked %ld, the C version %ld", c, bp.size(), count,
+		      pc.num_picked_BP(), cPicks.size());
+	}
+}
+
+int main()
+{
+	test_greedy_exact_count();
+	test_pareto_vs_verify();
+	test_deviation_linear_vs_bisect();
+	test_kernels_vs_scalar<double>();
+	test_kernels_vs_scalar<float>();
+	test_kernels_vs_scalar<Fixed32>();
+	test_optimal_vs_exact_dp();
+	test_error_bound();
+	test_binary_round_trip<double>();
+	test_binary_round_trip<float>();
+	test_binary_round_trip<Fixed32>();
+	test_parallel_parse();
+	test_lookup_vs_naive();
+	test_value_range<float>(1e39);
+	test_value_range<Fixed32>(214748.3648);
+	test_value_range<Fixed32>(300000);
+	test_edits_vs_recompute();
+	test_pool_concurrent_submit();
+	test_server_round_trip();
+	test_legacy_vs_c();
+
+	printf("%d checks, %d failed\n", checks.load(), failures.load());
+	return failures ? 1 : 0;
+}
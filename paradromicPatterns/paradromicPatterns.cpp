@@ -41,24 +41,263 @@
  *
  *
  *  Note, comments to the codes will be added later.
+ *
+ *  The palindromes are found with Manacher's algorithm: the radius of the longest palindrome around every centre, odd and
+ *  even, is computed in one O(n) pass, and the three detect functions walk over these radii instead of expanding pointers
+ *  outward from each centre again (O(n^2) on a long run of one letter). They pick the same patterns as the expansion did.
+ *
+ *  With --all every distinct paradromic pattern of two letters or more is listed, with the number of times it occurs. They
+ *  are the nodes of a palindromic tree (eertree) built in O(n): a node is one distinct palindrome, kept as the place of its
+ *  first occurrence in the string and its length, and it is only turned into a string when it is printed.
+ *
+ *    ./paradromicPatterns --all
+ *
+ *  The string is only read through a std::string_view, nothing is copied out of it while searching. A pattern found is kept
+ *  as its place and length in a flat hash table keyed by a rolling hash of the pattern, which is calculated in O(1) from
+ *  prefix hashes of the string, so a duplicate costs no string and no allocation.
+ *
+ *  A file of any size is scanned with --file: it is memory mapped one chunk at a time, each chunk with --overlap bytes of
+ *  the chunks before and after it, so that the patterns around its centres are found in full. Every pattern found is printed
+ *  as soon as its chunk is done, one line each (offset, length, pattern), duplicates too, as keeping the distinct ones would
+ *  take memory that grows with the file. Memory stays bounded by the chunk size, some 13 bytes per byte of a chunk and its
+ *  overlaps for the radii and the mapping. Patterns up to --overlap letters long are
+ *  found exactly like in a string; a longer one may be cut at the overlap.
+ *
+ *    ./paradromicPatterns --file archive.log --chunk 8388608 --overlap 65536 > patterns.txt
+ *
+ *  A long string is searched by several threads with --threads (0: one per core; built with -pthread), each one computes
+ *  the radii of a range of centres, reading the letters past it as it needs, and walks that range. A radius cut at the
+ *  start of a range is completed when a walk reads it. The patterns found by each thread are merged at the end, and the
+ *  result is the same as with one thread. Strings shorter than 64 KiB a thread use fewer threads.
+ *
+ *    ./paradromicPatterns --threads 8 < book.txt
  */
 
 #include <iostream>
-#include <map>
-#include <set>
 #include <iterator>
 #include <string>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
 #include <cstring>
+#include <string_view>
+#include <climits>
+#include <thread>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
-#define BUFF_SIZE 256
+#define CHUNK_SIZE  (8 << 20)                                   // default bytes of a file mapped and searched at a time
+#define OVERLAP_SIZE (64 << 10)                                 // default bytes a chunk reads of the chunks before and after it
+#ifndef MIN_RANGE_LENGTH
+#define MIN_RANGE_LENGTH (64 << 10)                             // fewest centres worth a thread of their own
+#endif
 
-// Struct to record the longest paradromic pattern
+// Struct to record the longest paradromic pattern, where it is in the string
 struct longestPattern
 {
-    int size;
-    char longPatt[BUFF_SIZE];
+    size_t size;
+    size_t offset;
+};
+
+// Node of the palindromic tree, one distinct palindrome
+struct palindromeNode
+{
+    long length;                                                // -1 for the root of the odd palindromes
+    size_t suffixLink;                                          // node of the longest palindrome that is a proper suffix of it
+    size_t child;                                               // first node that is this palindrome with one letter added on both sides
+    size_t sibling;                                             // next child of the same node
+    unsigned char letter;                                       // the letter added
+    size_t end;                                                 // last letter of its first occurrence in the string
+    size_t count;                                               // number of occurrences
+};
+
+
+// Runs work(0) .. work(threads - 1), each on a thread of its own (work(0) on the calling one), and waits for all of them
+template<class Work> static void runInThreads(unsigned threads, Work work)
+{
+    std::vector<std::thread> workers;
+
+    for(unsigned t = 1; t < threads; t++)
+        workers.emplace_back(work, t);
+    work(0);
+    for(auto &w : workers)
+        w.join();
+}
+
+// Rolling hash of any substring of a string in O(1), from the hashes of its prefixes. Read only once built, so the pattern
+// sets of many threads can share it.
+class PatternHashes
+{
+public:
+    void reset(std::string_view str, unsigned threads = 1);
+    uint64_t hashOf(size_t offset, size_t length) const;
+    std::string_view pattern(size_t offset, size_t length) const { return text.substr(offset, length); }
+
+private:
+    static constexpr uint64_t MOD = (1ULL << 61) - 1;          // Mersenne prime, products reduce with shifts
+    static constexpr uint64_t BASE = 1000003;
+
+    static uint64_t mulMod(uint64_t a, uint64_t b)
+    {
+        unsigned __int128 m = (unsigned __int128)a * b;
+        uint64_t r = (uint64_t)(m & MOD) + (uint64_t)(m >> 61);
+        return r >= MOD ? r - MOD : r;
+    }
+    static uint64_t addMod(uint64_t a, uint64_t b)
+    {
+        uint64_t r = a + b;
+        return r >= MOD ? r - MOD : r;
+    }
+
+    std::string_view text;
+    std::vector<uint64_t> prefixHash;                           // hash of the first i letters
+    std::vector<uint64_t> basePower;                            // BASE^i
+};
+
+// With threads, every part of the string is hashed as if it was the whole string, then the hash and the power of BASE at
+// the start of each part, known once the parts before it are done, are folded into it.
+void PatternHashes::reset(std::string_view str, unsigned threads)
+{
+    size_t n = str.length();
+    size_t partLength = (n + threads - 1) / threads;
+    std::vector<uint64_t> startHash(threads, 0), startPower(threads, 1);
+
+    text = str;
+    prefixHash.assign(n + 1, 0);
+    basePower.assign(n + 1, 1);
+    if(n == 0)
+        return;
+
+    runInThreads(threads, [&](unsigned t) {
+        size_t from = std::min(n, t * partLength), to = std::min(n, from + partLength);
+        uint64_t h = 0, power = 1;
+        for(size_t i = from; i < to; i++)
+        {
+            h = addMod(mulMod(h, BASE), (unsigned char)str[i] + 1);
+            power = mulMod(power, BASE);
+            prefixHash[i + 1] = h;
+            basePower[i + 1] = power;
+        }
+    });
+    for(unsigned t = 1; t < threads; t++)
+    {
+        size_t from = std::min(n, (t - 1) * partLength), end = std::min(n, t * partLength);
+        startHash[t] = end > from ? addMod(mulMod(startHash[t - 1], basePower[end]), prefixHash[end]) : startHash[t - 1];
+        startPower[t] = end > from ? mulMod(startPower[t - 1], basePower[end]) : startPower[t - 1];
+    }
+    runInThreads(threads, [&](unsigned t) {
+        size_t from = std::min(n, t * partLength), to = std::min(n, from + partLength);
+        if(t == 0)
+            return;
+        for(size_t i = from + 1; i <= to; i++)
+        {
+            prefixHash[i] = addMod(mulMod(startHash[t], basePower[i]), prefixHash[i]);
+            basePower[i] = mulMod(startPower[t], basePower[i]);
+        }
+    });
+}
+
+uint64_t PatternHashes::hashOf(size_t offset, size_t length) const
+{
+    return addMod(prefixHash[offset + length], MOD - mulMod(prefixHash[offset], basePower[length]));
+}
+
+
+// Set of distinct patterns of a string, each one kept as its place (the first one found) and length in the string. Flat
+// open addressing table with linear probing, keyed by a rolling hash of the pattern; patterns with the same hash are told
+// apart by comparing them, so a hash collision can not merge two patterns.
+class PatternSet
+{
+public:
+    struct entry
+    {
+        uint64_t hash;
+        size_t offset;
+        size_t length;                                          // 0: empty slot
+    };
+
+    void reset(const PatternHashes &patternHashes);
+    bool insert(size_t offset, size_t length) { return insert(entry{hashes->hashOf(offset, length), offset, length}); }
+    void merge(const PatternSet &other);                        // adds the patterns of a set over the same string
+    size_t size(void) const { return count; }
+    bool empty(void) const { return count == 0; }
+    std::string_view pattern(const entry &e) const { return hashes->pattern(e.offset, e.length); }
+    std::vector<entry> sortedPatterns(void) const;
+
+private:
+    bool insert(const entry &found);
+    void grow(void);
+
+    const PatternHashes *hashes{nullptr};
+    std::vector<entry> table;                                   // size a power of 2, at most half full
+    size_t count{0};
 };
 
+void PatternSet::reset(const PatternHashes &patternHashes)
+{
+    hashes = &patternHashes;
+    table.assign(16, entry{0, 0, 0});
+    count = 0;
+}
+
+bool PatternSet::insert(const entry &found)
+{
+    size_t mask = table.size() - 1;
+
+    for(size_t slot = found.hash & mask; ; slot = (slot + 1) & mask)
+    {
+        entry &e = table[slot];
+        if(e.length == 0)
+        {
+            e = found;
+            if(++count * 2 > table.size())
+                grow();
+            return true;
+        }
+        if(e.hash == found.hash && e.length == found.length && pattern(e) == pattern(found))
+            return false;
+    }
+}
+
+void PatternSet::merge(const PatternSet &other)
+{
+    for(auto &e : other.table)
+        if(e.length != 0)
+            insert(e);
+}
+void PatternSet::grow(void)
+{
+    std::vector<entry> old(table.size() * 2, entry{0, 0, 0});
+    size_t mask = old.size() - 1;
+
+    old.swap(table);
+    for(auto &e : old)
+    {
+        if(e.length == 0)
+            continue;
+        size_t slot = e.hash & mask;
+        while(table[slot].length != 0)
+            slot = (slot + 1) & mask;
+        table[slot] = e;
+    }
+}
+
+// The patterns in string order, for printing
+std::vector<PatternSet::entry> PatternSet::sortedPatterns(void) const
+{
+    std::vector<entry> patterns;
+
+    patterns.reserve(count);
+    for(auto &e : table)
+        if(e.length != 0)
+            patterns.push_back(e);
+    std::sort(patterns.begin(), patterns.end(), [this](const entry &a, const entry &b) { return pattern(a) < pattern(b); });
+    return patterns;
+}
+
 
 class ParadromicPatterns
 {
@@ -69,16 +308,42 @@ public:
     void receiveData(void);                                     // Interface fuctions
     void processData(void);
     void displayData(void);
+    void listAllPatterns(bool all) { allPatterns = all; }
+    void useThreads(unsigned n) { threads = std::max(n, 1u); }
+    int scanFile(const char *fileName, size_t chunkSize, size_t overlap);
     
 private:
     int myStringCompare(const char * str1, const char * str2);
-    int detectSameLetterPatterns(void);
-    int detectEvenParadromicPatterns(void);
-    int detectOddParadromicPatterns(void);
+    void computeRadii(void);
+    void computeRadii(size_t from, size_t to);
+    size_t oddRadiusAt(size_t i) const;
+    size_t evenRadiusAt(size_t i) const;
+    size_t runEndAt(size_t i) const;
+    void recordPattern(size_t offset, size_t length);
+    void printEscaped(std::string_view pattern);
+    template<class Record> size_t detectSameLetterPatterns(size_t from, size_t to, Record record) const;
+    template<class Record> size_t detectEvenParadromicPatterns(size_t from, size_t to, Record record) const;
+    template<class Record> size_t detectOddParadromicPatterns(size_t from, size_t to, Record record) const;
+    void detectInThreads(void);
+    size_t findChild(size_t node, unsigned char letter) const;
+    size_t findSuffixNode(size_t node, size_t i) const;
+    void buildPalindromeTree(void);
+    void displayAllPatterns(void);
     
     std::string dataString;
-    std::map<std::string, int> paradromicPatterns;
-    struct longestPattern longestPattern;
+    std::string_view text;                                      // the string searched, dataString or a mapped chunk of a file
+    size_t textOffset{0};                                       // offset of text in the file
+    bool allPatterns{false};
+    unsigned threads{1};
+    bool printPatterns{false};                                  // print every pattern found instead of keeping the distinct ones
+    size_t patternsFound{0};
+    std::vector<palindromeNode> palindromeTree;                 // [0] and [1] are the roots of the odd and the even palindromes
+    std::vector<uint32_t> oddRadius;                            // letters the palindrome centred on letter i reaches on each side
+    std::vector<uint32_t> evenRadius;                           // letter pairs of the palindrome centred between letters i and i+1
+    std::vector<uint32_t> runEnd;                               // last letter of the run of the same letter letter i is in
+    PatternHashes patternHashes;
+    PatternSet paradromicPatterns;
+    struct longestPattern longestPattern{};
 };
 
 ParadromicPatterns::ParadromicPatterns()=default;
@@ -93,213 +358,342 @@ int ParadromicPatterns::myStringCompare(const char * str1, const char * str2)
     return (int) (*str1 - *str2);
 }
 
-int ParadromicPatterns::detectSameLetterPatterns()
+void ParadromicPatterns::computeRadii(void)
 {
-    char *fwp, *bwp;
-    int numberOfPattern = 0;
-    int forwardCheck;
-    int i, strlength = dataString.length();
-    char charStr[dataString.length() + 1];
-    
-    // Convert to C string or use std::string::iterator, like:
-    //    std::string::iterator cppfwp, cppbwp;
-    //    cppfwp = cppbwp = dataString.begin();
-    //    cppbwp++;
-    strcpy(charStr, dataString.c_str());
-    fwp = &charStr[0];                                          // Set the pointers to point to letters
-    bwp = &charStr[1];
+    size_t n = text.length();
+
+    oddRadius.assign(n, 0);
+    evenRadius.assign(n, 0);
+    runEnd.assign(n, 0);
+    computeRadii(0, n);
+}
+
+// Manacher's algorithm: a centre inside the rightmost palindrome found so far starts from the radius of its mirror centre,
+// only the letters beyond that palindrome are compared, so the whole string is done in O(n).
+// The centres from .. to are done as if the string started at letter from, they read the letters after to though. A radius
+// cut short by that start is found in full by oddRadiusAt() and evenRadiusAt(), and a run cut at to by runEndAt().
+void ParadromicPatterns::computeRadii(size_t from, size_t to)
+{
+    size_t n = text.length();
+    const char *str = text.data();
+
+    for(size_t i = from, left = from, right = from; i < to; i++)       // odd: the palindrome str[left..right] reaches furthest
+    {
+        size_t k = i < right ? std::min<size_t>(oddRadius[left + right - i], right - i) : 0;
+        while(i - from >= k + 1 && i + k + 1 < n && str[i - k - 1] == str[i + k + 1])
+            k++;
+        oddRadius[i] = k;
+        if(i + k > right)
+        {
+            left = i - k;
+            right = i + k;
+        }
+    }
+
+    for(size_t i = from, left = from, right = from; i < to && i + 1 < n; i++)   // even: str[left..right), centre i, i+1
+    {
+        size_t k = i + 1 < right ? std::min<size_t>(evenRadius[left + right - i - 2], right - i - 1) : 0;
+        while(i - from >= k && i + k + 1 < n && str[i - k] == str[i + k + 1])
+            k++;
+        evenRadius[i] = k;
+        if(i + k + 1 > right)
+        {
+            left = i + 1 - k;
+            right = i + k + 1;
+        }
+    }
+
+    for(size_t i = to; i-- > from; )
+        runEnd[i] = (i + 1 < to && str[i] == str[i + 1]) ? runEnd[i + 1] : i;
+}
+
+// A radius is cut short only where the letters just outside it are the same, they are not beyond a longest palindrome
+size_t ParadromicPatterns::oddRadiusAt(size_t i) const
+{
+    size_t k = oddRadius[i];
+    while(i >= k + 1 && i + k + 1 < text.length() && text[i - k - 1] == text[i + k + 1])
+        k++;
+    return k;
+}
+
+size_t ParadromicPatterns::evenRadiusAt(size_t i) const
+{
+    size_t k = evenRadius[i];
+    while(i >= k && i + k + 1 < text.length() && text[i - k] == text[i + k + 1])
+        k++;
+    return k;
+}
+
+size_t ParadromicPatterns::runEndAt(size_t i) const
+{
+    size_t e = runEnd[i];
+    while(e + 1 < text.length() && text[e] == text[e + 1])       // the run goes on in the next range
+        e = runEnd[e + 1];
+    return e;
+}
+
+void ParadromicPatterns::recordPattern(size_t offset, size_t length)
+{
+    if(length > longestPattern.size)
+    {
+        longestPattern.offset = textOffset + offset;
+        longestPattern.size = length;
+    }
+    if(!printPatterns)
+    {
+        paradromicPatterns.insert(offset, length);
+        return;
+    }
+
+    patternsFound++;
+    std::cout << textOffset + offset << "\t" << length << "\t";
+    printEscaped(text.substr(offset, length));
+    std::cout << "\n";
+}
+
+// Quoted, with the bytes that are not printable as \xHH, so a pattern of a file is always on one line
+void ParadromicPatterns::printEscaped(std::string_view pattern)
+{
+    std::cout << "'";
+    for(unsigned char c : pattern)
+    {
+        if(c >= ' ' && c < 127 && c != '\\')
+            std::cout << c;
+        else
+        {
+            char esc[8];
+            snprintf(esc, sizeof(esc), "\\x%02x", c);
+            std::cout << esc;
+        }
+    }
+    std::cout << "'";
+}
+
+// Runs of one letter, "aa", "bbbb", but not of spaces. The detect functions walk from letter from up to letter to of text,
+// hand each pattern found to record(offset, length) and return the letter the walk goes on from, it can be beyond to.
+template<class Record> size_t ParadromicPatterns::detectSameLetterPatterns(size_t from, size_t to, Record record) const
+{
+    size_t i, end, strlength = text.length();
     
-    for(i=0; i < strlength-1; i++)                              // Walk through the string
+    for(i = from; i < to && i + 1 < strlength; i++)                      // Walk through the runs
     {
-        if(*fwp == *bwp)
+        end = runEndAt(i);
+        if(end > i)
         {
-            forwardCheck = 0;
-            numberOfPattern++;
-            while(bwp != &charStr[strlength-1])
-            {
-                bwp++;
-                if(*fwp == *bwp)
-                {
-                    forwardCheck++;
-                    if(bwp == &charStr[strlength-1])
-                        break;
-                }
-                else
-                {
-                    bwp--;
-                    break;
-                }
-            }
-            if(*fwp != ' ')
-            {
-                int length = bwp - fwp + 1;
-                if(length > longestPattern.size)
-                {
-                    strncpy(longestPattern.longPatt, fwp, length);
-                    longestPattern.size = length;
-                }
-                char tmp[BUFF_SIZE];
-                strncpy(tmp, fwp, length);
-                tmp[length] = '\0';
-                std::string cctmp(tmp);
-                if(paradromicPatterns.find(cctmp) == paradromicPatterns.end())
-                    paradromicPatterns.insert(std::pair<std::string,int>(cctmp, length) );
-            }
-            if(forwardCheck != 0)
-            {
-                fwp += forwardCheck + 1;
-                bwp++;
-                i += forwardCheck + 1;
-            }
+            if(text[i] != ' ')
+                record(i, end - i + 1);
+            i = end;
         }
-        fwp++;
-        bwp++;
     }
-    return numberOfPattern;
+    return i;
 }
 
-int ParadromicPatterns::detectEvenParadromicPatterns()
-{
-    char *fwp, *bwp;
-    int numberOfPattern = 0;
-    int expand;
-    int i, strlength = dataString.length();
-    char charStr[dataString.length() + 1];
-    // Convert to C string or use std::string::iterator, like:
-    //    std::string::iterator cppfwp, cppbwp;
-    //    cppfwp = cppbwp = dataString.begin();
-    //    cppbwp++;
-    strcpy(charStr, dataString.c_str());
-    fwp = &charStr[0];                                                // Set the pointers to point to letters
-    bwp = &charStr[1];
+// Even palindromes around two same letters, at least one pair more around them and not all one letter. The walk continues
+// behind a palindrome found, like the expansion did.
+template<class Record> size_t ParadromicPatterns::detectEvenParadromicPatterns(size_t from, size_t to, Record record) const
+{
+    size_t i, expand, strlength = text.length();
     
-    for(i=0; i < strlength-1; i++)                                    // Walk through the string
+    for(i = from; i < to && i + 1 < strlength; i++)                      // Walk through the centres
     {
-        if(*fwp == *bwp)
+        expand = evenRadiusAt(i);
+        if(expand > 0)
         {
-            expand = 0;
-            numberOfPattern++;
-            while(fwp != &charStr[0] &&  bwp != &charStr[strlength-1])
-            {
-                fwp--; bwp++;
-                if(*fwp == *bwp)
-                {
-                    expand++;
-                    if(fwp == &charStr[0] || bwp == &charStr[strlength-1])
-                        break;
-                }
-                else
-                {
-                    fwp++; bwp--;
-                    break;
-                }
-            }
-            if(expand > 0)
-            {
-                int notSame = 0, length = bwp - fwp + 1;
-                char *tempp = fwp;
-                while(bwp- ++tempp >= 0)
-                {
-                    if(*tempp != *fwp)
-                    {
-                        notSame = 1;
-                        break;
-                    }
-                }
-                if(notSame == 1)
-                {
-                    if(length > longestPattern.size)
-                    {
-                        strncpy(longestPattern.longPatt, fwp, length);
-                        longestPattern.longPatt[length]='\0';
-                        longestPattern.size = length;
-                    }
-                    char tmp[BUFF_SIZE];
-                    strncpy(tmp, fwp, length);
-                    tmp[length] = '\0';
-                    std::string cppstr(tmp);
-                    if(paradromicPatterns.find(cppstr) == paradromicPatterns.end())
-                        paradromicPatterns.emplace(cppstr, length);
-                }
-            }
+            expand--;
             if(expand > 0)
             {
-                fwp += expand*2 + 1;
-                bwp++;
+                size_t start = i - expand, length = 2 * (expand + 1);
+                if(runEndAt(start) < start + length - 1)
+                    record(start, length);
                 i += expand + 1;
             }
         }
-        fwp++; bwp++;
     }
     
-    return numberOfPattern;
+    return i;
 }
 
-int ParadromicPatterns::detectOddParadromicPatterns()
+// Odd palindromes, not all one letter
+template<class Record> size_t ParadromicPatterns::detectOddParadromicPatterns(size_t from, size_t to, Record record) const
 {
-    char *fwp, *bwp;
-    int numberOfPattern = 0;
-    int expand;
-    int i, strlength = dataString.length();
-    char charStr[dataString.length() + 1];
-    
-    // Convert to C string or use std::string::iterator, like:
-    //    std::string::iterator cppfwp, cppbwp;
-    //    cppfwp = cppbwp = dataString.begin();
-    strcpy(charStr, dataString.c_str());
-    fwp = bwp = &charStr[0];                                            // Set the pointers to point to letters
+    size_t i, expand, strlength = text.length();
     
-    for(i=0; i < strlength-1; i++)                                      // Walk through the string
+    for(i = from; i < to && i + 1 < strlength; i++)                      // Walk through the centres
     {
-        expand = 0;
-        while(fwp != &charStr[0] &&  bwp != &charStr[strlength-1])
+        expand = oddRadiusAt(i);
+        if(expand > 0)
         {
-            fwp--; bwp++;
-            if(*fwp == *bwp)
-            {
-                expand++;
-                if(fwp == &charStr[0] || bwp == &charStr[strlength-1])
-                    break;
-            }
-            else
-            {
-                fwp++; bwp--;
-                break;
-            }
+            size_t start = i - expand, length = 2 * expand + 1;
+            if(runEndAt(start) < start + length - 1)
+                record(start, length);
+            i += expand;
         }
-        if(expand > 0)
+    }
+    return i;
+}
+
+// The centres are split in a range for each thread. The radii of a range are computed by its thread, then each thread walks
+// its range and keeps the patterns in a set of its own, the sets are merged at the end. A walk has to enter a range where
+// the walk of the ranges before it leaves it: each thread first walks its range from its first letter without recording,
+// and the walk that comes in at another letter mostly joins that one within a few letters, after which it leaves the range
+// at the same letter.
+void ParadromicPatterns::detectInThreads(void)
+{
+    size_t n = text.length();
+    size_t rangeLength = (n + threads - 1) / threads;
+    auto noRecord = [](size_t, size_t) {};
+    std::vector<size_t> runLeave(threads), evenLeave(threads), oddLeave(threads);
+    std::vector<size_t> runEnter(threads, 0), evenEnter(threads, 0), oddEnter(threads, 0);
+    std::vector<PatternSet> found(threads);
+    std::vector<struct longestPattern> longestRun(threads), longestEven(threads), longestOdd(threads);
+
+    patternHashes.reset(text, threads);
+    paradromicPatterns.reset(patternHashes);
+    oddRadius.assign(n, 0);
+    evenRadius.assign(n, 0);
+    runEnd.assign(n, 0);
+
+    runInThreads(threads, [&](unsigned t) {
+        size_t from = std::min(n, t * rangeLength), to = std::min(n, from + rangeLength);
+        computeRadii(from, to);
+    });
+    runInThreads(threads, [&](unsigned t) {
+        size_t from = std::min(n, t * rangeLength), to = std::min(n, from + rangeLength);
+        runLeave[t] = detectSameLetterPatterns(from, to, noRecord);
+        evenLeave[t] = detectEvenParadromicPatterns(from, to, noRecord);
+        oddLeave[t] = detectOddParadromicPatterns(from, to, noRecord);
+    });
+
+    auto enter = [&](auto walk, std::vector<size_t> &enterAt, const std::vector<size_t> &leaveAt) {
+        for(unsigned t = 1; t < threads; t++)
         {
-            int notSame = 0, length = bwp - fwp + 1;
-            char *tempp = fwp;
-            while(bwp- ++tempp >= 0)
+            size_t to = std::min(n - 1, t * rangeLength);            // a walk ends at the last letter of the string
+            size_t at = enterAt[t - 1], first = std::min(to, (t - 1) * rangeLength);   // and from the first letter
+            while(at != first && at < to)
             {
-                if(*tempp != *fwp)
-                {
-                    notSame = 1;
-                    break;
-                }
-            }
-            if(notSame == 1)
-            {
-                if(length > longestPattern.size)
-                {
-                    strncpy(longestPattern.longPatt, fwp, length);
-                    longestPattern.size = length;
-                }
-                char tmp[BUFF_SIZE];
-                strncpy(tmp, fwp, length);
-                tmp[length] ='\0';
-                std::string cppstr(tmp);
-                if(paradromicPatterns.find(cppstr) == paradromicPatterns.end())
-                    paradromicPatterns.emplace(cppstr, length);
+                if(at < first)
+                    at = walk(at, at + 1);
+                else
+                    first = walk(first, first + 1);
             }
-            fwp += expand*2;
-            i += expand;
-            numberOfPattern++;
+            enterAt[t] = at == first ? leaveAt[t - 1] : at;
+        }
+    };
+    enter([&](size_t from, size_t to) { return detectSameLetterPatterns(from, to, noRecord); }, runEnter, runLeave);
+    enter([&](size_t from, size_t to) { return detectEvenParadromicPatterns(from, to, noRecord); }, evenEnter, evenLeave);
+    enter([&](size_t from, size_t to) { return detectOddParadromicPatterns(from, to, noRecord); }, oddEnter, oddLeave);
+
+    runInThreads(threads, [&](unsigned t) {
+        size_t to = std::min(n, (t + 1) * rangeLength);
+        auto recordInto = [&](struct longestPattern &longest) {
+            return [&](size_t offset, size_t length) {
+                if(length > longest.size)
+                    longest = {length, offset};
+                found[t].insert(offset, length);
+            };
+        };
+        found[t].reset(patternHashes);
+        detectSameLetterPatterns(runEnter[t], to, recordInto(longestRun[t]));
+        detectEvenParadromicPatterns(evenEnter[t], to, recordInto(longestEven[t]));
+        detectOddParadromicPatterns(oddEnter[t], to, recordInto(longestOdd[t]));
+    });
+
+    for(auto *longest : {&longestRun, &longestEven, &longestOdd})   // the first one of the longest, as the walks one by one
+        for(auto &l : *longest)
+            if(l.size > longestPattern.size)
+                longestPattern = l;
+    for(auto &f : found)
+        paradromicPatterns.merge(f);
+}
+
+// Child of node for the letter, 0 if there is none (node 0 is never a child)
+size_t ParadromicPatterns::findChild(size_t node, unsigned char letter) const
+{
+    for(size_t c = palindromeTree[node].child; c != 0; c = palindromeTree[c].sibling)
+        if(palindromeTree[c].letter == letter)
+            return c;
+    return 0;
+}
+
+// Longest palindrome on the suffix link chain of node that the letter i extends, it has the same letter just before it
+size_t ParadromicPatterns::findSuffixNode(size_t node, size_t i) const
+{
+    while(1)
+    {
+        long length = palindromeTree[node].length;
+        if((long)i - 1 - length >= 0 && text[i - 1 - length] == text[i])
+            return node;
+        node = palindromeTree[node].suffixLink;
+    }
+}
+
+// Add the letters one by one. The longest palindrome ending at a letter is the one ending at the letter before, or a palindrome
+// on its suffix link chain, with the letter added on both sides; at most one new distinct palindrome per letter.
+void ParadromicPatterns::buildPalindromeTree(void)
+{
+    size_t n = text.length(), last = 1;
+
+    palindromeTree.clear();
+    palindromeTree.reserve(n + 2);
+    palindromeTree.push_back({-1, 0, 0, 0, 0, 0, 0});
+    palindromeTree.push_back({0, 0, 0, 0, 0, 0, 0});
+
+    for(size_t i = 0; i < n; i++)
+    {
+        unsigned char letter = text[i];
+        size_t parent = findSuffixNode(last, i);
+        size_t node = findChild(parent, letter);
+
+        if(node == 0)
+        {
+            palindromeNode pn{palindromeTree[parent].length + 2, 1, 0, palindromeTree[parent].child, letter, i, 0};
+            if(pn.length > 1)
+                pn.suffixLink = findChild(findSuffixNode(palindromeTree[parent].suffixLink, i), letter);
+            node = palindromeTree.size();
+            palindromeTree.push_back(pn);
+            palindromeTree[parent].child = node;
         }
-        fwp++; bwp++;
+        palindromeTree[node].count++;
+        last = node;
     }
-    return numberOfPattern;
+
+    // a palindrome also occurs wherever one that ends with it occurs, the longer nodes come later
+    for(size_t node = palindromeTree.size(); node-- > 2; )
+        palindromeTree[palindromeTree[node].suffixLink].count += palindromeTree[node].count;
+}
+
+// Every distinct pattern of two letters or more with its number of occurrences, in the order of the patterns
+void ParadromicPatterns::displayAllPatterns(void)
+{
+    std::vector<size_t> nodes;
+    size_t longest = 0;
+    auto pattern = [this](size_t node)
+    {
+        const palindromeNode &pn = palindromeTree[node];
+        return text.substr(pn.end + 1 - pn.length, pn.length);
+    };
+
+    for(size_t node = 2; node < palindromeTree.size(); node++)
+        if(palindromeTree[node].length >= 2)
+        {
+            nodes.push_back(node);
+            if(palindromeTree[node].length > palindromeTree[longest].length)
+                longest = node;
+        }
+
+    if(nodes.empty())
+    {
+        std::cout << "There is no paradromic pattern in the string." << "\n";
+        return;
+    }
+    std::sort(nodes.begin(), nodes.end(), [&](size_t a, size_t b) { return pattern(a) < pattern(b); });
+
+    std::cout << "Found " << nodes.size() << " distinct paradromic patterns:" << "\n";
+    std::cout << text << "\n";
+    for(size_t node : nodes)
+        std::cout << "'" << pattern(node) << "' x" << palindromeTree[node].count << "  ";
+    std::cout << "\n\n";
+    std::cout << "The longest pattern is: '" << pattern(longest) << "' Size=" << palindromeTree[longest].length << "\n";
 }
 
 void ParadromicPatterns::receiveData(void)
@@ -310,11 +704,26 @@ void ParadromicPatterns::receiveData(void)
 
 void ParadromicPatterns::processData(void)
 {
-    if(!dataString.empty())
+    text = dataString;
+    if(text.length() > UINT32_MAX)
+        std::cout << "User data is too long, scan it with --file! " << "\n";
+    else if(!text.empty() && allPatterns)
+        buildPalindromeTree();
+    else if(!text.empty())
     {
-        detectSameLetterPatterns();
-        detectEvenParadromicPatterns();
-        detectOddParadromicPatterns();
+        threads = std::max<size_t>(1, std::min<size_t>(threads, text.length() / MIN_RANGE_LENGTH));
+        if(threads > 1)
+            detectInThreads();
+        else
+        {
+            auto record = [this](size_t offset, size_t length) { recordPattern(offset, length); };
+            patternHashes.reset(text);
+            paradromicPatterns.reset(patternHashes);
+            computeRadii();
+            detectSameLetterPatterns(0, text.length(), record);
+            detectEvenParadromicPatterns(0, text.length(), record);
+            detectOddParadromicPatterns(0, text.length(), record);
+        }
     }
     else
         std::cout << "User data is empty, nothig to process! " << "\n";
@@ -323,23 +732,144 @@ void ParadromicPatterns::processData(void)
 void ParadromicPatterns::displayData(void)
 {
     
-    if(!paradromicPatterns.empty())
+    if(allPatterns)
+        displayAllPatterns();
+    else if(!paradromicPatterns.empty())
     {
         std::cout << "Found " << paradromicPatterns.size() << " paradromic patterns:" << "\n";
-        std::cout << dataString << "\n";
-        for(auto &kv : paradromicPatterns)
-            std::cout << "'" << kv.first << "'" <<"  ";
+        std::cout << text << "\n";
+        for(auto &e : paradromicPatterns.sortedPatterns())
+            std::cout << "'" << paradromicPatterns.pattern(e) << "'" <<"  ";
         std::cout << "\n\n";
-        std::cout << "The longest pattern is: '" << longestPattern.longPatt << "' Size=" << longestPattern.size << "\n";
+        std::cout << "The longest pattern is: '" << text.substr(longestPattern.offset, longestPattern.size) << "' Size="
+                  << longestPattern.size << "\n";
     }
     else
      std::cout << "There is no paradromic pattern in the string." << "\n";
  }
 
-int main()
+// Each chunk [start, end) of the file is mapped with overlap bytes on both sides and its centres are searched, the three walks
+// go on in the next chunk from where they left this one, so they skip the same centres they do in a string.
+int ParadromicPatterns::scanFile(const char *fileName, size_t chunkSize, size_t overlap)
+{
+    int fd = open(fileName, O_RDONLY);
+    struct stat st;
+    if(fd < 0 || fstat(fd, &st) != 0)
+    {
+        std::cerr << "Cannot open " << fileName << ": " << strerror(errno) << "\n";
+        if(fd >= 0)
+            close(fd);
+        return 1;
+    }
+
+    size_t fileSize = st.st_size, pageSize = sysconf(_SC_PAGESIZE);
+    size_t nextRun = 0, nextEven = 0, nextOdd = 0;
+    auto record = [this](size_t offset, size_t length) { recordPattern(offset, length); };
+    struct longestPattern longestRun{}, longestEven{}, longestOdd{};   // kept per walk, to break ties the way a string does
+
+    printPatterns = true;
+    for(size_t start = 0; start < fileSize; start += chunkSize)
+    {
+        size_t end = std::min(fileSize, start + chunkSize);
+        size_t winStart = start > overlap ? start - overlap : 0;
+        size_t winEnd = std::min(fileSize, end + overlap);
+        size_t mapStart = winStart / pageSize * pageSize;            // mmap wants a page aligned offset
+        size_t mapLength = winEnd - mapStart;
+
+        void *map = mmap(nullptr, mapLength, PROT_READ, MAP_PRIVATE, fd, mapStart);
+        if(map == MAP_FAILED)
+        {
+            std::cerr << "Cannot map " << fileName << ": " << strerror(errno) << "\n";
+            close(fd);
+            return 1;
+        }
+        madvise(map, mapLength, MADV_SEQUENTIAL);
+
+        text = std::string_view(static_cast<const char *>(map) + (winStart - mapStart), winEnd - winStart);
+        textOffset = winStart;
+        computeRadii();
+        longestPattern = longestRun;
+        nextRun = detectSameLetterPatterns(std::max(nextRun, start) - winStart, end - winStart, record) + winStart;
+        longestRun = longestPattern;
+        longestPattern = longestEven;
+        nextEven = detectEvenParadromicPatterns(std::max(nextEven, start) - winStart, end - winStart, record) + winStart;
+        longestEven = longestPattern;
+        longestPattern = longestOdd;
+        nextOdd = detectOddParadromicPatterns(std::max(nextOdd, start) - winStart, end - winStart, record) + winStart;
+        longestOdd = longestPattern;
+
+        text = std::string_view();
+        munmap(map, mapLength);
+    }
+
+    longestPattern = longestRun;
+    if(longestEven.size > longestPattern.size)
+        longestPattern = longestEven;
+    if(longestOdd.size > longestPattern.size)
+        longestPattern = longestOdd;
+
+    if(patternsFound == 0)
+        std::cout << "There is no paradromic pattern in " << fileName << "\n";
+    else
+    {
+        std::string longest(longestPattern.size, '\0');
+        if(pread(fd, longest.data(), longest.size(), longestPattern.offset) != (ssize_t) longest.size())
+            longest.clear();
+        std::cout << "Found " << patternsFound << " paradromic patterns in " << fileName << "\n";
+        std::cout << "The longest pattern is at " << longestPattern.offset << ": ";
+        printEscaped(longest);
+        std::cout << " Size=" << longestPattern.size << "\n";
+    }
+    close(fd);
+    return 0;
+}
+
+int main(int argc, char *argv[])
 {
     ParadromicPatterns pp;
+    const char *fileName = nullptr;
+    size_t chunkSize = CHUNK_SIZE, overlap = OVERLAP_SIZE;
+    bool all = false;
+    unsigned threads = 1;
     
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "--all") == 0)
+            all = true;
+        else if(strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            threads = strtoul(argv[++i], nullptr, 10);
+        else if(strcmp(argv[i], "--file") == 0 && i + 1 < argc)
+            fileName = argv[++i];
+        else if(strcmp(argv[i], "--chunk") == 0 && i + 1 < argc)
+            chunkSize = strtoull(argv[++i], nullptr, 10);
+        else if(strcmp(argv[i], "--overlap") == 0 && i + 1 < argc)
+            overlap = strtoull(argv[++i], nullptr, 10);
+        else
+        {
+            std::cout << "Usage: " << argv[0] << " [--all] | [--threads <n>]"
+                      << " | [--file <path> [--chunk <bytes>] [--overlap <bytes>]]" << "\n";
+            return strcmp(argv[i], "--help") == 0 ? 0 : 1;
+        }
+    }
+    if(fileName)
+    {
+        if(all || threads != 1 || chunkSize == 0 || overlap == 0 || chunkSize + 2 * overlap > UINT32_MAX)
+        {
+            std::cout << "--file takes a chunk and an overlap of 1 byte or more, under 4 GiB together,"
+                      << " and no --all or --threads" << "\n";
+            return 1;
+        }
+        return pp.scanFile(fileName, chunkSize, overlap);
+    }
+    if(all && threads != 1)
+    {
+        std::cout << "--all builds the palindromic tree on one thread, it takes no --threads" << "\n";
+        return 1;
+    }
+    if(threads == 0)
+        threads = std::max(std::thread::hardware_concurrency(), 1u);
+    pp.listAllPatterns(all);
+    pp.useThreads(threads);
     pp.receiveData();
     pp.processData();
     pp.displayData();